@@ -7,7 +7,7 @@
   enum { AM_##reg = (id) }; \
   typedef struct { __VA_ARGS__; } AM_##reg##_T;
 
-AM_DEVREG( 1, UART_CONFIG,  RD, bool present);
+AM_DEVREG( 1, UART_CONFIG,  RD, bool present, has_txbuf);
 AM_DEVREG( 2, UART_TX,      WR, char data);
 AM_DEVREG( 3, UART_RX,      RD, char data);
 AM_DEVREG( 4, TIMER_CONFIG, RD, bool present, has_rtc);
@@ -31,6 +31,10 @@ AM_DEVREG(21, NET_CONFIG,   RD, bool present);
 AM_DEVREG(22, NET_STATUS,   RD, int rx_len, tx_len);
 AM_DEVREG(23, NET_TX,       WR, Area buf);
 AM_DEVREG(24, NET_RX,       WR, Area buf);
+AM_DEVREG(25, GPU_FILL,     WR, int x, y, w, h; uint32_t color);
+AM_DEVREG(26, GPU_BLIT,     WR, int x, y, w, h; void *pixels; int pw, ph; uint32_t *palette);
+AM_DEVREG(27, GPU_COPY,     WR, int x, y, w, h, sx, sy);
+AM_DEVREG(28, UART_TXBUF,   WR, Area buf);
 
 // Input
 
@@ -49,8 +53,17 @@ enum {
   AM_KEYS(AM_KEY_NAMES)
 };
 
+// UART
+
+// With has_txbuf, UART_TXBUF sends the bytes in `buf', which is faster
+// than calling putch() for each of them.
+
 // GPU
 
+// With has_accel, GPU_FILL, GPU_BLIT and GPU_COPY are supported:
+// GPU_BLIT scales pw * ph pixels to w * h, and the pixels are indices of
+// `palette' when it is not NULL; GPU_COPY moves the w * h rectangle at
+// (sx, sy) of the screen to (x, y). Call GPU_FBDRAW with sync to show them.
 #define AM_GPU_TEXTURE  1
 #define AM_GPU_SUBTREE  2
 #define AM_GPU_NULL     0xffffffff
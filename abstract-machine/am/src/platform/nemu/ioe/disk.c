@@ -1,12 +1,52 @@
 #include <am.h>
 #include <nemu.h>
 
+#define DISK_BLKSZ_ADDR      (DISK_ADDR + 0x00)
+#define DISK_BLKCNT_ADDR     (DISK_ADDR + 0x04)
+#define DISK_QUEUE_ADDR_ADDR (DISK_ADDR + 0x08)
+#define DISK_QUEUE_SIZE_ADDR (DISK_ADDR + 0x0c)
+#define DISK_AVAIL_ADDR      (DISK_ADDR + 0x10)
+#define DISK_USED_ADDR       (DISK_ADDR + 0x14)
+#define DISK_INTR_ADDR       (DISK_ADDR + 0x18)
+
+#define QUEUE_SIZE 8
+
+// a request in the descriptor ring, see nemu/src/device/disk.c
+typedef struct {
+  uint32_t write;
+  uint32_t blkno;
+  uint32_t blkcnt;
+  uint32_t buf;
+  uint32_t status;
+} DiskDesc;
+
+static volatile DiskDesc queue[QUEUE_SIZE];
+static uint32_t avail = 0;
+
+void __am_disk_init() {
+  outl(DISK_QUEUE_ADDR_ADDR, (uintptr_t)queue);
+  outl(DISK_QUEUE_SIZE_ADDR, QUEUE_SIZE);
+}
+
 void __am_disk_config(AM_DISK_CONFIG_T *cfg) {
-  cfg->present = false;
+  cfg->blksz = inl(DISK_BLKSZ_ADDR);
+  cfg->blkcnt = inl(DISK_BLKCNT_ADDR);
+  cfg->present = (cfg->blkcnt != 0);
 }
 
 void __am_disk_status(AM_DISK_STATUS_T *stat) {
+  stat->ready = (inl(DISK_USED_ADDR) == avail);
 }
 
 void __am_disk_blkio(AM_DISK_BLKIO_T *io) {
+  volatile DiskDesc *d = &queue[avail % QUEUE_SIZE];
+  d->write = io->write;
+  d->blkno = io->blkno;
+  d->blkcnt = io->blkcnt;
+  d->buf = (uintptr_t)io->buf;
+  outl(DISK_AVAIL_ADDR, ++ avail);
+  // the whole transfer is done by the device, just wait for its completion
+  while (inl(DISK_USED_ADDR) != avail);
+  outl(DISK_INTR_ADDR, 0);
+  panic_on(d->status != 0, "disk I/O error");
 }
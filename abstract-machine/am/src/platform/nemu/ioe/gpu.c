@@ -1,42 +1,63 @@
 #include <am.h>
 #include <nemu.h>
 
-#define SYNC_ADDR (VGACTL_ADDR + 4)
+#define SYNC_ADDR       (VGACTL_ADDR + 4)
+#define QUEUE_ADDR_ADDR (VGACTL_ADDR + 8)
+#define QUEUE_SIZE_ADDR (VGACTL_ADDR + 12)
+#define AVAIL_ADDR      (VGACTL_ADDR + 16)
+#define USED_ADDR       (VGACTL_ADDR + 20)
+
+#define QUEUE_SIZE 8
+
+// a command of the 2D engine, see nemu/src/device/vga.c
+enum { GPU_FILL = 1, GPU_BLIT, GPU_BLIT8 };
+
+typedef struct {
+  uint32_t op, color, src, pitch, sw, sh;
+  int32_t x, y, w, h;
+} GpuCmd;
+
+static volatile GpuCmd queue[QUEUE_SIZE];
+static uint32_t avail = 0;
+static int screen_w = 0, screen_h = 0;  // the geometry does not change
+
+// the command is done by the device when outl() returns
+static void submit(GpuCmd cmd) {
+  queue[avail % QUEUE_SIZE] = cmd;
+  outl(AVAIL_ADDR, ++ avail);
+}
 
 void __am_gpu_init() {
   int i;
   uint32_t screen_wh = inl(VGACTL_ADDR);
-  int w = (screen_wh >> 16) & 0xffff;
-  int h = screen_wh & 0xffff;
+  screen_w = (screen_wh >> 16) & 0xffff;
+  screen_h = screen_wh & 0xffff;
   uint32_t *fb = (uint32_t *)(uintptr_t)FB_ADDR;
-  for (i = 0; i < w * h; i ++) fb[i] = i;
+  for (i = 0; i < screen_w * screen_h; i ++) fb[i] = i;
   outl(SYNC_ADDR, 1);
+  outl(QUEUE_ADDR_ADDR, (uintptr_t)queue);
+  outl(QUEUE_SIZE_ADDR, QUEUE_SIZE);
 }
 
 void __am_gpu_config(AM_GPU_CONFIG_T *cfg) {
-  uint32_t screen_wh = inl(VGACTL_ADDR);
-  uint32_t h = screen_wh & 0xffff;
-  uint32_t w = (screen_wh >> 16) & 0xffff;
   *cfg = (AM_GPU_CONFIG_T) {
-    .present = true, .has_accel = false,
-    .width = w, .height = h,
+    .present = true, .has_accel = true,
+    .width = screen_w, .height = screen_h,
     .vmemsz = 0
   };
 }
 
 void __am_gpu_fbdraw(AM_GPU_FBDRAW_T *ctl) {
-  if (!ctl->sync && ctl->w == 0 && ctl->h == 0) {
-    return ;
-  }
-
-  uint32_t *fb = (uint32_t *)(uintptr_t)FB_ADDR;
-  uint32_t *pixels = ctl->pixels;
-  uint32_t screen_w = (inl(VGACTL_ADDR) >> 16) & 0xffff;
-
-  for (int j = ctl->y; j < ctl->y + ctl->h; j++) {
-    for (int i = ctl->x; i < ctl->x + ctl->w; i++) {
-      fb[j * screen_w + i] = pixels[ctl->w * (j - ctl->y) + (i - ctl->x)];
-    }
+  // clip the rectangle here, so that the device copies whole rows, and
+  // the whole rectangle at once for full-width draws
+  int x0 = (ctl->x > 0 ? ctl->x : 0), x1 = ctl->x + ctl->w;
+  int y0 = (ctl->y > 0 ? ctl->y : 0), y1 = ctl->y + ctl->h;
+  if (x1 > screen_w) x1 = screen_w;
+  if (y1 > screen_h) y1 = screen_h;
+  if (x0 < x1 && y0 < y1) {
+    uint32_t *pixels = (uint32_t *)ctl->pixels + (y0 - ctl->y) * ctl->w + (x0 - ctl->x);
+    submit((GpuCmd) { .op = GPU_BLIT, .src = (uintptr_t)pixels, .pitch = ctl->w,
+        .sw = x1 - x0, .sh = y1 - y0, .x = x0, .y = y0, .w = x1 - x0, .h = y1 - y0 });
   }
 
   if (ctl->sync) {
@@ -44,6 +65,22 @@ void __am_gpu_fbdraw(AM_GPU_FBDRAW_T *ctl) {
   }
 }
 
+void __am_gpu_fill(AM_GPU_FILL_T *ctl) {
+  submit((GpuCmd) { .op = GPU_FILL, .color = ctl->color,
+      .x = ctl->x, .y = ctl->y, .w = ctl->w, .h = ctl->h });
+}
+
+void __am_gpu_blit(AM_GPU_BLIT_T *ctl) {
+  submit((GpuCmd) { .op = (ctl->palette ? GPU_BLIT8 : GPU_BLIT),
+      .color = (uintptr_t)ctl->palette, .src = (uintptr_t)ctl->pixels, .pitch = ctl->pw,
+      .sw = ctl->pw, .sh = ctl->ph, .x = ctl->x, .y = ctl->y, .w = ctl->w, .h = ctl->h });
+}
+
+void __am_gpu_copy(AM_GPU_COPY_T *ctl) {
+  submit((GpuCmd) { .op = GPU_BLIT, .src = FB_ADDR + (ctl->sy * screen_w + ctl->sx) * sizeof(uint32_t),
+      .pitch = screen_w, .sw = ctl->w, .sh = ctl->h, .x = ctl->x, .y = ctl->y, .w = ctl->w, .h = ctl->h });
+}
+
 void __am_gpu_status(AM_GPU_STATUS_T *status) {
-  status->ready = true;
+  status->ready = (inl(USED_ADDR) == avail);
 }
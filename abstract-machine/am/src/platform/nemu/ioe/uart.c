@@ -0,0 +1,21 @@
+#include <am.h>
+#include <nemu.h>
+
+void __am_uart_config(AM_UART_CONFIG_T *cfg) {
+  cfg->present = false;
+  cfg->has_txbuf = true;
+}
+
+// SERIAL_TX_ADDR sends the bytes of a word from the lowest one and stops
+// at '\0', so pack up to 4 bytes per write, and send a '\0' by itself
+void __am_uart_txbuf(AM_UART_TXBUF_T *tx) {
+  const uint8_t *p = tx->buf.start, *end = tx->buf.end;
+  while (p < end) {
+    uint32_t word = 0;
+    int n = 0;
+    for (; n < 4 && p + n < end && p[n] != '\0'; n ++) word |= (uint32_t)p[n] << (n * 8);
+    if (n == 0) { outb(SERIAL_PORT, *p ++); continue; }
+    outl(SERIAL_TX_ADDR, word);
+    p += n;
+  }
+}
@@ -21,6 +21,7 @@ static int uart_init() {
 
 static void uart_config(AM_UART_CONFIG_T *cfg) {
   cfg->present = true;
+  cfg->has_txbuf = false;
 }
 
 static void uart_tx(AM_UART_TX_T *send) {
@@ -4,11 +4,40 @@
 
 #if !defined(__ISA_NATIVE__) || defined(__NATIVE_USE_KLIB__)
 
+#ifdef __NEMU_HOSTCALL__
+// Let NEMU do the operation on the host, see nemu/src/engine/interpreter/hostcall.c.
+// The result is in a0, and a3 is 0 when it is done, otherwise we should do it.
+#define HOSTCALL_MEMCPY  0
+#define HOSTCALL_MEMSET  1
+#define HOSTCALL_MEMMOVE 2
+#define HOSTCALL_MEMCMP  3
+#define HOSTCALL_STRLEN  4
+
+#define _hostcall(op, x, y, z, ...) ({ \
+  register uintptr_t _a0 asm("a0") = (uintptr_t)(x); \
+  register uintptr_t _a1 asm("a1") = (uintptr_t)(y); \
+  register uintptr_t _a2 asm("a2") = (uintptr_t)(z); \
+  register uintptr_t _a3 asm("a3"); \
+  asm volatile (".insn r 0x0b, %4, 0, x0, x0, x0" \
+      : "+r"(_a0), "=r"(_a3) : "r"(_a1), "r"(_a2), "i"(op) : "memory"); \
+  __VA_ARGS__; \
+  _a3 == 0; \
+})
+#define hostcall(op, x, y, z) _hostcall(op, x, y, z)
+#define hostcall_ret(op, ret, x, y, z) _hostcall(op, x, y, z, ret = _a0)
+#else
+#define hostcall(op, x, y, z) false
+#define hostcall_ret(op, ret, x, y, z) ({ (void)(ret); false; })
+#endif
+
 size_t strlen(const char *s) {
   if (s == NULL) {
     panic("s is null pointer!");
   }
 
+  uintptr_t ret;
+  if (hostcall_ret(HOSTCALL_STRLEN, ret, s, 0, 0)) return ret;
+
   size_t len = 0;
   while (*s != '\0') {
     len++;
@@ -114,6 +143,8 @@ void *memset(void *s, int c, size_t n) {
     panic("s is null pointer!");
   }
 
+  if (hostcall(HOSTCALL_MEMSET, s, c, n)) return s;
+
   unsigned char *ptr = s;
   while (n--) {
     *ptr = c;
@@ -128,6 +159,8 @@ void *memmove(void *dst, const void *src, size_t n) {
     panic("dst or src is null pointer!");
   }
 
+  if (hostcall(HOSTCALL_MEMMOVE, dst, src, n)) return dst;
+
   unsigned char *ptr1 = dst;
   const unsigned char *ptr2 = src;
 
@@ -155,6 +188,8 @@ void *memcpy(void *out, const void *in, size_t n) {
     panic("out or in is null pointer!");
   }
 
+  if (hostcall(HOSTCALL_MEMCPY, out, in, n)) return out;
+
   unsigned char *ptr1 = out;
   const unsigned char *ptr2 = in;
   while (n--) {
@@ -171,6 +206,9 @@ int memcmp(const void *s1, const void *s2, size_t n) {
     panic("s1 or s2 is null pointer!");
   }
 
+  uintptr_t ret;
+  if (hostcall_ret(HOSTCALL_MEMCMP, ret, s1, s2, n)) return (int)ret;
+
   const unsigned char *ptr1 = s1, *ptr2 = s2;
 
   while (n--) {
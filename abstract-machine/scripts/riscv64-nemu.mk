@@ -1,6 +1,7 @@
 include $(AM_HOME)/scripts/isa/riscv.mk
 include $(AM_HOME)/scripts/platform/nemu.mk
 CFLAGS  += -DISA_H=\"riscv/riscv.h\"
+CFLAGS  += $(if $(NO_HOSTCALL),,-D__NEMU_HOSTCALL__)  # klib uses the hostcall instruction of NEMU
 
 AM_SRCS += riscv/nemu/start.S \
            riscv/nemu/cte.c \
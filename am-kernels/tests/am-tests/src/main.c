@@ -11,6 +11,7 @@ static const char *tests[256] = {
   ['t'] = "real-time clock test",
   ['k'] = "readkey test",
   ['v'] = "display test",
+  ['f'] = "fill rate benchmark",
   ['a'] = "audio test",
   ['p'] = "x86 virtual memory test",
 };
@@ -24,6 +25,7 @@ int main(const char *args) {
     CASE('t', rtc_test, IOE);
     CASE('k', keyboard_test, IOE);
     CASE('v', video_test, IOE);
+    CASE('f', fillrate_test, IOE);
     CASE('a', audio_test, IOE);
     CASE('p', vm_test, CTE(vm_handler), VME(simple_pgalloc, simple_pgfree));
     case 'H':
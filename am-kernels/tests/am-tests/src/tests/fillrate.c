@@ -0,0 +1,38 @@
+#include <amtest.h>
+
+#define DURATION_US 1000000
+
+static uint64_t uptime() {
+  return io_read(AM_TIMER_UPTIME).us;
+}
+
+// draw `w' * `h' rectangles over the screen for a while, return kilo-pixels per second
+static int fill_rate(uint32_t *buf, int w, int h) {
+  AM_GPU_CONFIG_T cfg = io_read(AM_GPU_CONFIG);
+  uint64_t pixels = 0, start = uptime(), now;
+  int x = 0, y = 0;
+  do {
+    io_write(AM_GPU_FBDRAW, x, y, buf, w, h, false);
+    pixels += w * h;
+    if ((x += w) + w > cfg.width) {
+      x = 0;
+      if ((y += h) + h > cfg.height) y = 0;
+    }
+  } while ((now = uptime()) - start < DURATION_US);
+  io_write(AM_GPU_FBDRAW, 0, 0, NULL, 0, 0, true);
+  return pixels * 1000 / (now - start);
+}
+
+void fillrate_test() {
+  AM_GPU_CONFIG_T cfg = io_read(AM_GPU_CONFIG);
+  int w = cfg.width, h = cfg.height;
+  uint32_t *buf = heap.start;
+  assert((void *)(buf + w * h) <= heap.end);
+  for (int i = 0; i < w * h; i ++) buf[i] = i * 0x10203;
+
+  printf("Screen %d x %d, fill rate in Kpixels/s:\n", w, h);
+  printf("  full screen : %d\n", fill_rate(buf, w, h));
+  printf("  quarter     : %d\n", fill_rate(buf, w / 2, h / 2));
+  printf("  32 x 32     : %d\n", fill_rate(buf, 32, 32));
+  printf("  8 x 8       : %d\n", fill_rate(buf, 8, 8));
+}
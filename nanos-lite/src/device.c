@@ -14,7 +14,13 @@ static const char *keyname[256] __attribute__((used)) = {
   AM_KEYS(NAME)
 };
 
+static bool has_txbuf = false;
+
 size_t serial_write(const void *buf, size_t offset, size_t len) {
+  if (has_txbuf) {
+    io_write(AM_UART_TXBUF, RANGE(buf, buf + len));
+    return len;
+  }
   for (size_t i = 0; i < len; i++) {
     putch(*(char*)(buf + i));
   }
@@ -55,4 +61,5 @@ size_t fb_write(const void *buf, size_t offset, size_t len) {
 void init_device() {
   Log("Initializing devices...");
   ioe_init();
+  has_txbuf = io_read(AM_UART_CONFIG).has_txbuf;
 }
@@ -0,0 +1,53 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __CPU_BPRED_H__
+#define __CPU_BPRED_H__
+
+#include <common.h>
+
+enum { BR_COND, BR_JUMP, BR_CALL, BR_RET, BR_IND };
+
+typedef struct {
+  vaddr_t pc;
+  vaddr_t target; // the actual next pc
+  int kind;
+  bool taken;
+} Branch;
+
+/* A predictor makes its prediction of the branch, then learns the actual
+ * outcome. `predict' returns 1 if the prediction is correct, 0 if it is
+ * not, and -1 if the branch is not of its business (e.g. a return for a
+ * direction predictor). All enabled predictors see the same branch stream.
+ */
+typedef struct {
+  const char *name;
+  void (*init)();
+  int (*predict)(const Branch *br);
+} BPredictor;
+
+void init_bpred();
+void bpred_update(vaddr_t pc, int kind, bool taken, vaddr_t target);
+void bpred_report();
+
+// 2-bit saturating counter, return the prediction before the update
+static inline bool bpred_ctr_update(uint8_t *ctr, bool taken) {
+  bool pred = (*ctr >= 2);
+  if (taken) { if (*ctr < 3) (*ctr) ++; }
+  else { if (*ctr > 0) (*ctr) --; }
+  return pred;
+}
+
+#endif
@@ -0,0 +1,60 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __CPU_BREAKPOINT_H__
+#define __CPU_BREAKPOINT_H__
+
+#include <common.h>
+#include <memory/vaddr.h>
+
+#ifdef CONFIG_BREAKPOINT
+/* Breakpoints are kept in an open-addressing hash set keyed by pc. A
+ * second hash set keyed by page holds a bitmap of the breakpoints in each
+ * page. While there are breakpoints, execute() compares the page of the
+ * pc with the last one after every instruction, looks up the page only
+ * when they differ, and tests a bit for each instruction inside a
+ * flagged page.
+ */
+extern int nr_bp;
+extern bool bp_hit;
+
+bool bp_insert(vaddr_t pc);
+bool bp_remove(vaddr_t pc);
+bool bp_find(vaddr_t pc);
+// the bitmap of the page of `pc', or NULL if there is no breakpoint in it
+const uint64_t* bp_page_map(vaddr_t pc);
+
+// one bit for every 2 bytes, the smallest instruction
+#define BP_MAP_BIT(pc) (((pc) & (PAGE_SIZE - 1)) >> 1)
+
+static inline bool bp_map_test(const uint64_t *map, vaddr_t pc) {
+  return (map[BP_MAP_BIT(pc) / 64] >> (BP_MAP_BIT(pc) % 64)) & 1;
+}
+
+/* Memory watchpoints, checked on data accesses. A hit stops the CPU
+ * after the current instruction. */
+enum { MW_WRITE = 1, MW_READ = 2, MW_ACCESS = 3 };
+
+extern int nr_mw;
+extern bool mw_hit;
+extern vaddr_t mw_hit_addr;
+extern int mw_hit_type;
+
+bool mw_insert(vaddr_t addr, int len, int type);
+bool mw_remove(vaddr_t addr, int len, int type);
+void mw_check(vaddr_t addr, int len, int type);
+#endif
+
+#endif
@@ -0,0 +1,36 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __CPU_COVERAGE_H__
+#define __CPU_COVERAGE_H__
+
+#include <common.h>
+
+// one bit for each possible start of an instruction in pmem
+#define COV_SHIFT MUXDEF(CONFIG_ISA_x86, 0, 2)
+#define COV_MAP_SIZE (CONFIG_MSIZE >> COV_SHIFT >> 3)
+
+extern uint8_t *cov_map;
+
+void init_coverage(const char *file);
+void coverage_report();
+
+// called at the entry of each basic block
+static inline void cov_mark(vaddr_t pc) {
+  word_t off = pc - CONFIG_MBASE;
+  if (likely(off < CONFIG_MSIZE)) cov_map[off >> (COV_SHIFT + 3)] |= 1 << ((off >> COV_SHIFT) & 7);
+}
+
+#endif
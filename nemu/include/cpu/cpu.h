@@ -19,6 +19,8 @@
 #include <common.h>
 
 void cpu_exec(uint64_t n);
+// print the host time and the number of instructions of g_machine
+void statistic();
 
 void set_nemu_state(int state, vaddr_t pc, int halt_ret);
 void invalid_inst(vaddr_t thispc);
@@ -26,6 +28,10 @@ void invalid_inst(vaddr_t thispc);
 #define NEMUTRAP(thispc, code) set_nemu_state(NEMU_END, thispc, code)
 #define INV(thispc) invalid_inst(thispc)
 
+// bulk memory operations done by the host for the hostcall instruction
+enum { HOSTCALL_MEMCPY, HOSTCALL_MEMSET, HOSTCALL_MEMMOVE, HOSTCALL_MEMCMP, HOSTCALL_STRLEN };
+bool hostcall_mem(int op, word_t *ret, word_t a0, word_t a1, word_t a2);
+
 // ftrace
 struct func_info {
     char func_name[128];
@@ -47,4 +53,16 @@ int find_func_name(vaddr_t addr);
 void func_trace_call(vaddr_t pc, vaddr_t target, bool tail_call);
 void func_trace_ret(vaddr_t pc);
 
+// profiler
+void init_profile(const char *file);
+void profile_call(vaddr_t pc, vaddr_t target, bool tail_call);
+void profile_ret();
+void profile_sample(vaddr_t pc);
+void profile_report();
+
+// basic block vectors
+void init_bbv(const char *file);
+void bbv_block(vaddr_t pc, uint32_t len);
+void bbv_report();
+
 #endif
@@ -0,0 +1,48 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __CPU_EVENT_H__
+#define __CPU_EVENT_H__
+
+#include <common.h>
+
+/* Events scheduled in virtual time, e.g. the deadline of a timer. The
+ * virtual time is the instruction count plus the time skipped by idling
+ * in event_idle(). The execute loop only compares the instruction count
+ * with the earliest deadline, which also covers the end of cpu_exec(),
+ * and checks for pending interrupts after the due events are handled.
+ * Anything which may unmask a pending interrupt, like a write to a CSR,
+ * calls event_kick() to have the check done before the next instruction.
+ */
+
+#define NR_EVENT 4
+
+typedef void (*event_handler_t)();
+
+typedef struct {
+  uint64_t when;  // UINT64_MAX if not scheduled
+  event_handler_t handler;
+} Event;
+
+int event_add(event_handler_t handler);
+void event_set(int id, uint64_t when);
+void event_dispatch();
+void event_idle();
+uint64_t event_deadline();
+
+#define vtime() (g_nr_guest_inst + g_machine->idle_ticks)
+#define event_kick() (g_machine->next_event = g_machine->deadline = 0)
+
+#endif
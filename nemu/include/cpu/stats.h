@@ -0,0 +1,61 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __CPU_STATS_H__
+#define __CPU_STATS_H__
+
+#include <common.h>
+#include <memory/paddr.h>
+
+#ifdef CONFIG_STATS
+/* Every instruction pattern owns a counter, which is linked into the
+ * list of the report when the pattern is executed the first time.
+ * The counters are shared by all machines in the process.
+ */
+typedef struct InstStat {
+  const char *name;
+  uint64_t count;
+  struct InstStat *next;
+} InstStat;
+
+typedef struct {
+  uint64_t load[4], store[4]; // indexed by log2(width)
+  uint64_t pmem, mmio;
+  uint64_t branch[2];         // not taken, taken
+} Stats;
+
+extern Stats g_stats;
+
+void stats_register(InstStat *st);
+void stats_display();
+void stats_json(FILE *fp);
+
+#define STATS_INST(mnemonic) do { \
+  static InstStat __inst_stat = { .name = str(mnemonic) }; \
+  if (unlikely(__inst_stat.count ++ == 0)) stats_register(&__inst_stat); \
+} while (0)
+
+#define STATS_BRANCH(taken) (g_stats.branch[!!(taken)] ++)
+
+static inline void stats_mem(paddr_t addr, int len, bool is_write) {
+  int w = (len == 8 ? 3 : len >> 1);
+  if (is_write) g_stats.store[w] ++;
+  else g_stats.load[w] ++;
+  if (likely(in_pmem(addr))) g_stats.pmem ++;
+  else g_stats.mmio ++;
+}
+#endif
+
+#endif
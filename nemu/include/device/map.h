@@ -18,6 +18,8 @@
 
 #include <cpu/difftest.h>
 
+#define NR_MAP 16
+
 typedef void(*io_callback_t)(uint32_t, int, bool);
 uint8_t* new_space(int size);
 
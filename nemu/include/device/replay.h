@@ -0,0 +1,28 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __DEVICE_REPLAY_H__
+#define __DEVICE_REPLAY_H__
+
+#include <common.h>
+
+// the devices whose inputs are nondeterministic
+enum { RR_RTC, RR_KEYBOARD, RR_NR_DEV };
+
+void init_replay(const char *record_file, const char *replay_file);
+uint64_t rr_input(int dev, uint64_t val);
+bool rr_replaying();
+
+#endif
@@ -0,0 +1,89 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __MACHINE_H__
+#define __MACHINE_H__
+
+#include <isa.h>
+#include <device/map.h>
+#include <cpu/event.h>
+
+struct watchpoint;
+struct func_info;
+struct ret_info;
+
+/* All the state of one simulated computer. Several machines can live in
+ * one process; each thread runs the machine pointed to by `g_machine'.
+ */
+typedef struct Machine {
+  CPU_state cpu;
+  NEMUState state;
+  bool headless;      // created by machine_create(), without devices or reports
+  uint64_t nr_guest_inst;
+  uint64_t timer_us;  // host time spent in cpu_exec()
+
+  // events scheduled in virtual time
+  Event events[NR_EVENT];
+  int nr_event;
+  uint64_t next_event; // the earliest deadline
+  uint64_t deadline;   // min(next_event, the end of cpu_exec()) in instruction count
+  uint64_t idle_ticks; // virtual time skipped by idling
+
+  // memory
+  uint8_t *pmem;
+
+  // device
+  uint8_t *io_space, *p_space;
+  IOMap mmio_maps[NR_MAP];
+  int nr_mmio_map;
+  IOMap pio_maps[NR_MAP];
+  int nr_pio_map;
+  uint64_t nr_io; // the number of device accesses
+
+  // sdb
+  struct watchpoint *wp_pool, *wp_head, *wp_free;
+
+  // ftrace
+  struct func_info *func_table;
+  size_t func_table_size;
+  struct ret_info *ret_list;
+  int func_call_depth;
+} Machine;
+
+#define MACHINE_TLS MUXDEF(CONFIG_TARGET_AM, , __thread __attribute__((tls_model("initial-exec"))))
+
+extern MACHINE_TLS Machine *g_machine;
+
+#define cpu             (g_machine->cpu)
+#define nemu_state      (g_machine->state)
+#define g_nr_guest_inst (g_machine->nr_guest_inst)
+#define func_table      (g_machine->func_table)
+#define func_table_size (g_machine->func_table_size)
+
+/* C API to drive machines other than the one set up by the monitor.
+ * Such machines are headless: devices are only attached to the default
+ * machine, so MMIO accesses from them are reported as out of bound, and
+ * nothing is printed when the program ends unless machine_report() is
+ * called. machine_create() returns NULL when NEMU is built with a feature
+ * whose state is shared by the whole process, e.g. CONFIG_STATS.
+ */
+Machine* machine_create();
+void machine_destroy(Machine *m);
+void machine_load(Machine *m, const void *img, size_t size);
+int machine_run(Machine *m, uint64_t n);
+int machine_step(Machine *m);
+void machine_report(Machine *m);
+
+#endif
@@ -0,0 +1,32 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __MEMORY_CACHE_H__
+#define __MEMORY_CACHE_H__
+
+#include <common.h>
+
+/* A functional model of the L1I/L1D/L2 hierarchy. It only tracks tags to
+ * count hits and misses; data always comes from pmem. The caches are
+ * shared by all machines in the process.
+ */
+void init_cache();
+void cache_ifetch(paddr_t addr);
+void cache_data(paddr_t addr, bool is_write);
+// a device wrote [addr, addr + len) in memory, drop the stale lines
+void cache_dma(paddr_t addr, size_t len);
+void cache_report();
+
+#endif
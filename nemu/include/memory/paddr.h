@@ -34,4 +34,10 @@ static inline bool in_pmem(paddr_t addr) {
 word_t paddr_read(paddr_t addr, int len);
 void paddr_write(paddr_t addr, int len, word_t data);
 
+/* Devices access pmem with memcpy() through guest_to_host(). Call this
+ * for such an access, so that the watchpoints, the cache simulator and
+ * the reference of DiffTest see it. It is not an instruction of the
+ * guest, and is not counted in the statistics. */
+void paddr_dma(paddr_t addr, size_t len, bool is_write);
+
 #endif
@@ -0,0 +1,63 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __NEMU_PLUGIN_H__
+#define __NEMU_PLUGIN_H__
+
+/* The interface between NEMU and instrumentation plugins. A plugin is a
+ * shared object loaded with --plugin=FILE.so[,ARGS]. It must define
+ * nemu_plugin_install(), which subscribes to events through the function
+ * table given by NEMU. This header is self-contained so that plugins can be
+ * built out of the tree.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define NEMU_PLUGIN_VERSION 1
+#define NEMU_PLUGIN_EXPORT __attribute__((visibility("default")))
+
+// an instruction is retired
+typedef void (*nemu_insn_cb_t)(void *udata, uint64_t pc, uint32_t inst);
+// the first instruction of a basic block is about to execute
+typedef void (*nemu_block_cb_t)(void *udata, uint64_t pc);
+// a data access, `data' is the value read or written
+typedef void (*nemu_mem_cb_t)(void *udata, uint64_t addr, int len, bool is_write, uint64_t data);
+// an exception or interrupt is raised, e.g. by ecall
+typedef void (*nemu_trap_cb_t)(void *udata, uint64_t cause, uint64_t epc);
+// the guest program has ended
+typedef void (*nemu_exit_cb_t)(void *udata);
+
+typedef struct {
+  int version;
+  const char *isa;
+
+  void (*register_insn_cb)(nemu_insn_cb_t cb, void *udata);
+  void (*register_block_cb)(nemu_block_cb_t cb, void *udata);
+  void (*register_mem_cb)(nemu_mem_cb_t cb, void *udata);
+  void (*register_trap_cb)(nemu_trap_cb_t cb, void *udata);
+  void (*register_exit_cb)(nemu_exit_cb_t cb, void *udata);
+
+  uint64_t (*read_reg)(int idx);
+  uint64_t (*read_pc)();
+  // only pmem can be read, other addresses read as 0
+  uint64_t (*read_mem)(uint64_t addr, int len);
+  uint64_t (*nr_guest_inst)();
+} nemu_plugin_api;
+
+// return 0 on success
+NEMU_PLUGIN_EXPORT int nemu_plugin_install(const nemu_plugin_api *api, const char *args);
+
+#endif
@@ -0,0 +1,48 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __PLUGIN_H__
+#define __PLUGIN_H__
+
+#include <common.h>
+
+#ifdef CONFIG_PLUGIN
+enum { PLUGIN_INSN, PLUGIN_BLOCK, PLUGIN_MEM, PLUGIN_TRAP, PLUGIN_EXIT, NR_PLUGIN_EVENT };
+
+#define MAX_PLUGIN_CB 8
+
+typedef struct {
+  int nr;
+  struct {
+    void *cb;
+    void *udata;
+  } cb[MAX_PLUGIN_CB];
+} PluginEvent;
+
+extern PluginEvent plugin_events[NR_PLUGIN_EVENT];
+
+/* Check this before calling plugin_xxx(), so that an event without
+ * subscribers only costs a well-predicted branch. */
+#define PLUGIN_ON(ev) unlikely(plugin_events[ev].nr != 0)
+
+void init_plugin(const char *spec);
+void plugin_insn(vaddr_t pc, uint32_t inst);
+void plugin_block(vaddr_t pc);
+void plugin_mem(vaddr_t addr, int len, bool is_write, word_t data);
+void plugin_trap(word_t cause, vaddr_t epc);
+void plugin_exit();
+#endif
+
+#endif
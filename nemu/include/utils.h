@@ -28,8 +28,6 @@ typedef struct {
   uint32_t halt_ret;
 } NEMUState;
 
-extern NEMUState nemu_state;
-
 // ----------- timer -----------
 
 uint64_t get_time();
@@ -56,13 +54,22 @@ uint64_t get_time();
 
 #define ANSI_FMT(str, fmt) fmt str ANSI_NONE
 
+#ifdef CONFIG_ASYNC_LOG
+void log_async(const char *fmt, ...);
+#define log_print(...) log_async(__VA_ARGS__)
+#else
+#define log_print(...) do { \
+    extern FILE* log_fp; \
+    fprintf(log_fp, __VA_ARGS__); \
+    fflush(log_fp); \
+  } while (0)
+#endif
+
 #define log_write(...) IFDEF(CONFIG_TARGET_NATIVE_ELF, \
   do { \
-    extern FILE* log_fp; \
     extern bool log_enable(); \
     if (log_enable()) { \
-      fprintf(log_fp, __VA_ARGS__); \
-      fflush(log_fp); \
+      log_print(__VA_ARGS__); \
     } \
   } while (0) \
 )
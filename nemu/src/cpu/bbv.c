@@ -0,0 +1,122 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <cpu/cpu.h>
+
+#ifdef CONFIG_BBV
+
+/* Basic block vectors for SimPoint. Every CONFIG_BBV_INTERVAL instructions,
+ * a line of the ".bb" format is written:
+ *   T:id:count :id:count ...
+ * where `id' numbers the blocks from 1 in the order of their first
+ * execution, and `count' is the number of instructions executed in the
+ * block during the interval.
+ */
+
+typedef struct {
+  vaddr_t pc;
+  uint64_t count;  // instructions in this interval
+} Block;
+
+static FILE *bbv_fp = NULL;
+static Block *blocks = NULL;
+static int nr_block = 0, max_block = 0;
+static int *hash = NULL;  // pc -> index of blocks + 1, 0 for empty
+static uint32_t hash_mask = 0;
+static int *touched = NULL;  // blocks executed in this interval
+static int nr_touched = 0;
+static uint64_t interval_inst = 0;
+static int nr_interval = 0;
+
+static inline uint32_t hash_pc(vaddr_t pc) {
+  return (uint32_t)((pc >> 2) * 0x9e3779b1u);
+}
+
+static void hash_insert(int idx) {
+  uint32_t h = hash_pc(blocks[idx].pc) & hash_mask;
+  while (hash[h] != 0) h = (h + 1) & hash_mask;
+  hash[h] = idx + 1;
+}
+
+static int new_block(vaddr_t pc) {
+  if (nr_block == max_block) {
+    max_block = (max_block == 0 ? 1024 : max_block * 2);
+    blocks = realloc(blocks, sizeof(Block) * max_block);
+    touched = realloc(touched, sizeof(int) * max_block);
+    free(hash);
+    // keep the load factor of the hash table under 1/2
+    hash_mask = max_block * 2 - 1;
+    hash = calloc(hash_mask + 1, sizeof(int));
+    assert(blocks && touched && hash);
+    for (int i = 0; i < nr_block; i ++) hash_insert(i);
+  }
+  blocks[nr_block] = (Block) { .pc = pc, .count = 0 };
+  hash_insert(nr_block);
+  return nr_block ++;
+}
+
+void init_bbv(const char *file) {
+  if (file == NULL) return;
+  bbv_fp = fopen(file, "w");
+  Assert(bbv_fp, "Can not open '%s'", file);
+  Log("BBV: %s, interval = %d instructions, written to %s", ANSI_FMT("ON", ANSI_FG_GREEN),
+      CONFIG_BBV_INTERVAL, file);
+}
+
+static void dump_interval() {
+  fputc('T', bbv_fp);
+  for (int i = 0; i < nr_touched; i ++) {
+    Block *b = &blocks[touched[i]];
+    fprintf(bbv_fp, ":%d:%" PRIu64 " ", touched[i] + 1, b->count);
+    b->count = 0;
+  }
+  fputc('\n', bbv_fp);
+  nr_touched = 0;
+  nr_interval ++;
+}
+
+// a block of `len' instructions starting at `pc' is executed
+void bbv_block(vaddr_t pc, uint32_t len) {
+  if (bbv_fp == NULL) return;
+  uint32_t h = hash_pc(pc) & hash_mask;
+  int idx;
+  while (true) {
+    idx = (hash != NULL ? hash[h] - 1 : -1);
+    if (idx < 0) { idx = new_block(pc); break; }
+    if (blocks[idx].pc == pc) break;
+    h = (h + 1) & hash_mask;
+  }
+  Block *b = &blocks[idx];
+  if (b->count == 0) touched[nr_touched ++] = idx;
+  b->count += len;
+
+  interval_inst += len;
+  if (interval_inst >= CONFIG_BBV_INTERVAL) {
+    // the overshoot is counted in the next interval, so that interval k
+    // starts at about k * CONFIG_BBV_INTERVAL instructions
+    interval_inst -= CONFIG_BBV_INTERVAL;
+    dump_interval();
+  }
+}
+
+void bbv_report() {
+  if (bbv_fp == NULL) return;
+  if (nr_touched > 0) dump_interval();
+  fclose(bbv_fp);
+  bbv_fp = NULL;
+  Log("BBV: %d intervals, %d basic blocks", nr_interval, nr_block);
+}
+#endif
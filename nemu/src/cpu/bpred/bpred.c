@@ -0,0 +1,117 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <cpu/cpu.h>
+#include <cpu/bpred.h>
+
+#ifdef CONFIG_BPRED
+
+#define NR_FUNC_TO_REPORT 10
+
+extern BPredictor bpred_bimodal, bpred_gshare, bpred_tage, bpred_btb, bpred_ras;
+
+static BPredictor *predictors[] = {
+  IFDEF(CONFIG_BPRED_BIMODAL, &bpred_bimodal,)
+  IFDEF(CONFIG_BPRED_GSHARE, &bpred_gshare,)
+  IFDEF(CONFIG_BPRED_TAGE, &bpred_tage,)
+  IFDEF(CONFIG_BPRED_BTB, &bpred_btb,)
+  IFDEF(CONFIG_BPRED_RAS, &bpred_ras,)
+};
+
+#define NR_PRED ARRLEN(predictors)
+
+static uint64_t nr_access[NR_PRED], nr_miss[NR_PRED];
+
+// per function statistics, only available with the symbol table
+static uint64_t *func_inst = NULL;
+static uint64_t *func_miss = NULL; // [func][predictor]
+static uint64_t last_inst = 0;
+
+void init_bpred() {
+  for (int i = 0; i < NR_PRED; i ++) {
+    predictors[i]->init();
+    Log("Branch predictor: %s", predictors[i]->name);
+  }
+  if (func_table != NULL) {
+    func_inst = calloc(func_table_size, sizeof(uint64_t));
+    func_miss = calloc(func_table_size * NR_PRED, sizeof(uint64_t));
+    assert(func_inst && func_miss);
+  }
+}
+
+void bpred_update(vaddr_t pc, int kind, bool taken, vaddr_t target) {
+  Branch br = { .pc = pc, .target = target, .kind = kind, .taken = taken };
+  int func = -1;
+  if (func_inst != NULL) {
+    // the instructions since the last branch belong to the function of this branch,
+    // and the branch itself is not counted in g_nr_guest_inst yet
+    func = find_func_name(pc);
+    func_inst[func] += g_nr_guest_inst + 1 - last_inst;
+    last_inst = g_nr_guest_inst + 1;
+  }
+  for (int i = 0; i < NR_PRED; i ++) {
+    int ret = predictors[i]->predict(&br);
+    if (ret < 0) continue;
+    nr_access[i] ++;
+    if (ret == 0) {
+      nr_miss[i] ++;
+      if (func >= 0) func_miss[func * NR_PRED + i] ++;
+    }
+  }
+}
+
+static double mpki(uint64_t miss, uint64_t inst) {
+  return (inst == 0 ? 0 : miss * 1000.0 / inst);
+}
+
+static uint64_t func_total_miss(int f) {
+  uint64_t sum = 0;
+  for (int i = 0; i < NR_PRED; i ++) sum += func_miss[f * NR_PRED + i];
+  return sum;
+}
+
+static int cmp_func(const void *a, const void *b) {
+  uint64_t x = func_total_miss(*(const int *)a), y = func_total_miss(*(const int *)b);
+  return (x < y) - (x > y);
+}
+
+void bpred_report() {
+  for (int i = 0; i < NR_PRED; i ++) {
+    Log("%-8s: %" PRIu64 " branches, %" PRIu64 " mispredictions (%.2f%%), MPKI = %.3f",
+        predictors[i]->name, nr_access[i], nr_miss[i],
+        (nr_access[i] == 0 ? 0 : nr_miss[i] * 100.0 / nr_access[i]),
+        mpki(nr_miss[i], g_nr_guest_inst));
+  }
+  if (func_inst == NULL || func_table == NULL || NR_PRED == 0) return;
+
+  int idx[func_table_size];
+  for (int f = 0; f < func_table_size; f ++) idx[f] = f;
+  qsort(idx, func_table_size, sizeof(int), cmp_func);
+
+  char buf[256], *p = buf;
+  p += sprintf(p, "%-24s %12s", "MPKI of function", "insts");
+  for (int i = 0; i < NR_PRED; i ++) p += sprintf(p, " %8s", predictors[i]->name);
+  Log("%s", buf);
+  for (int k = 0; k < NR_FUNC_TO_REPORT && k < func_table_size; k ++) {
+    int f = idx[k];
+    if (func_total_miss(f) == 0) break;
+    p = buf;
+    p += sprintf(p, "%-24.24s %12" PRIu64, func_table[f].func_name, func_inst[f]);
+    for (int i = 0; i < NR_PRED; i ++) p += sprintf(p, " %8.3f", mpki(func_miss[f * NR_PRED + i], func_inst[f]));
+    Log("%s", buf);
+  }
+}
+#endif
@@ -0,0 +1,44 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <cpu/bpred.h>
+
+#ifdef CONFIG_BPRED_BTB
+
+#define NR_ENTRY (1 << CONFIG_BPRED_BTB_BITS)
+
+// direct mapped, a zero pc means an invalid entry
+static struct {
+  vaddr_t pc, target;
+} btb[NR_ENTRY];
+
+static void init() {
+  memset(btb, 0, sizeof(btb));
+}
+
+/* Only the target of taken branches is predicted here. The direction of
+ * conditional branches is the job of the direction predictors, and
+ * returns are left to the RAS. */
+static int predict(const Branch *br) {
+  if (!br->taken || br->kind == BR_RET) return -1;
+  int idx = (br->pc >> 2) & (NR_ENTRY - 1);
+  bool hit = (btb[idx].pc == br->pc && btb[idx].target == br->target);
+  btb[idx].pc = br->pc;
+  btb[idx].target = br->target;
+  return hit;
+}
+
+BPredictor bpred_btb = { .name = "btb", .init = init, .predict = predict };
+#endif
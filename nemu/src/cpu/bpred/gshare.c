@@ -0,0 +1,38 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <cpu/bpred.h>
+
+#ifdef CONFIG_BPRED_GSHARE
+
+#define NR_ENTRY (1 << CONFIG_BPRED_GSHARE_BITS)
+
+static uint8_t ctr[NR_ENTRY];
+static uint64_t ghr = 0; // global history, the youngest branch is bit 0
+
+static void init() {
+  memset(ctr, 1, sizeof(ctr));
+}
+
+static int predict(const Branch *br) {
+  if (br->kind != BR_COND) return -1;
+  uint8_t *c = &ctr[((br->pc >> 2) ^ ghr) & (NR_ENTRY - 1)];
+  bool pred = bpred_ctr_update(c, br->taken);
+  ghr = (ghr << 1) | br->taken;
+  return pred == br->taken;
+}
+
+BPredictor bpred_gshare = { .name = "gshare", .init = init, .predict = predict };
+#endif
@@ -0,0 +1,46 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <cpu/bpred.h>
+
+#ifdef CONFIG_BPRED_RAS
+
+#define DEPTH CONFIG_BPRED_RAS_DEPTH
+
+// circular, so deep recursion overwrites the oldest entries
+static vaddr_t stack[DEPTH];
+static int top = 0, nr_valid = 0;
+
+static void init() {
+  top = nr_valid = 0;
+}
+
+static int predict(const Branch *br) {
+  if (br->kind == BR_CALL) {
+    top = (top + 1) % DEPTH;
+    stack[top] = br->pc + 4;
+    if (nr_valid < DEPTH) nr_valid ++;
+    return -1;
+  }
+  if (br->kind != BR_RET) return -1;
+  if (nr_valid == 0) return 0;
+  vaddr_t pred = stack[top];
+  top = (top + DEPTH - 1) % DEPTH;
+  nr_valid --;
+  return pred == br->target;
+}
+
+BPredictor bpred_ras = { .name = "ras", .init = init, .predict = predict };
+#endif
@@ -0,0 +1,122 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <cpu/bpred.h>
+
+#ifdef CONFIG_BPRED_TAGE
+
+/* A small TAGE: a bimodal base predictor and 4 tagged tables indexed with
+ * geometrically increasing lengths of the global history. The longest
+ * matching table provides the prediction. On a misprediction, an entry is
+ * allocated in a longer table whose useful counter is 0. */
+
+#define NR_TABLE   4
+#define BASE_BITS  CONFIG_BPRED_TAGE_BITS
+#define TABLE_BITS (CONFIG_BPRED_TAGE_BITS - 2)
+#define TAG_BITS   9
+#define U_RESET_PERIOD (256 * 1024)
+
+static const int hist_len[NR_TABLE] = { 5, 12, 27, 60 };
+
+typedef struct {
+  bool valid; // never allocated entries match no tag, including 0
+  uint16_t tag;
+  int8_t ctr; // 3-bit signed, taken if >= 0
+  uint8_t u;  // 2-bit useful counter
+} Entry;
+
+static uint8_t base[1 << BASE_BITS];
+static Entry table[NR_TABLE][1 << TABLE_BITS];
+static uint64_t ghr = 0;
+static uint32_t nr_branch = 0;
+
+static void init() {
+  memset(base, 1, sizeof(base));
+  memset(table, 0, sizeof(table));
+}
+
+// fold the youngest `len' bits of the history into `bits' bits
+static uint32_t fold(int len, int bits) {
+  uint64_t h = (len >= 64 ? ghr : ghr & ((1ull << len) - 1));
+  uint32_t ret = 0;
+  for (; h != 0; h >>= bits) ret ^= h & ((1u << bits) - 1);
+  return ret;
+}
+
+static int predict(const Branch *br) {
+  if (br->kind != BR_COND) return -1;
+  uint32_t pc = br->pc >> 2;
+  bool taken = br->taken;
+  uint32_t idx[NR_TABLE];
+  uint16_t tag[NR_TABLE];
+  int provider = -1, alt = -1;
+
+  for (int i = NR_TABLE - 1; i >= 0; i --) {
+    idx[i] = (pc ^ (pc >> (TABLE_BITS - i)) ^ fold(hist_len[i], TABLE_BITS)) & ((1 << TABLE_BITS) - 1);
+    tag[i] = (pc ^ fold(hist_len[i], TAG_BITS) ^ (fold(hist_len[i], TAG_BITS - 1) << 1)) & ((1 << TAG_BITS) - 1);
+    if (table[i][idx[i]].valid && table[i][idx[i]].tag == tag[i]) {
+      if (provider < 0) provider = i;
+      else if (alt < 0) alt = i;
+    }
+  }
+
+  uint8_t *b = &base[pc & ((1 << BASE_BITS) - 1)];
+  bool base_pred = (*b >= 2);
+  bool alt_pred = (alt >= 0 ? table[alt][idx[alt]].ctr >= 0 : base_pred);
+  bool pred = (provider >= 0 ? table[provider][idx[provider]].ctr >= 0 : base_pred);
+
+  if (provider >= 0) {
+    Entry *e = &table[provider][idx[provider]];
+    if (pred != alt_pred) {
+      if (pred == taken) { if (e->u < 3) e->u ++; }
+      else { if (e->u > 0) e->u --; }
+    }
+    if (taken) { if (e->ctr < 3) e->ctr ++; }
+    else { if (e->ctr > -4) e->ctr --; }
+  } else {
+    bpred_ctr_update(b, taken);
+  }
+
+  if (pred != taken) {
+    bool allocated = false;
+    for (int i = provider + 1; i < NR_TABLE; i ++) {
+      Entry *e = &table[i][idx[i]];
+      if (e->u == 0) {
+        e->valid = true;
+        e->tag = tag[i];
+        e->ctr = (taken ? 0 : -1);
+        allocated = true;
+        break;
+      }
+    }
+    if (!allocated) {
+      for (int i = provider + 1; i < NR_TABLE; i ++) {
+        if (table[i][idx[i]].u > 0) table[i][idx[i]].u --;
+      }
+    }
+  }
+
+  if (++ nr_branch % U_RESET_PERIOD == 0) {
+    for (int i = 0; i < NR_TABLE; i ++) {
+      for (int j = 0; j < (1 << TABLE_BITS); j ++) table[i][j].u >>= 1;
+    }
+  }
+
+  ghr = (ghr << 1) | taken;
+  return pred == taken;
+}
+
+BPredictor bpred_tage = { .name = "tage", .init = init, .predict = predict };
+#endif
@@ -0,0 +1,143 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <cpu/breakpoint.h>
+#include <memory/vaddr.h>
+
+#ifdef CONFIG_BREAKPOINT
+
+#define HASH_BITS 10
+#define HASH_SIZE (1 << HASH_BITS)
+#define MAX_BP    (HASH_SIZE / 2)
+
+#define EMPTY ((vaddr_t)-1)
+#define TOMB  ((vaddr_t)-2)
+
+int nr_bp = 0;
+bool bp_hit = false;
+
+static vaddr_t bp_table[HASH_SIZE] = { [0 ... HASH_SIZE - 1] = EMPTY };
+static vaddr_t page_table[HASH_SIZE] = { [0 ... HASH_SIZE - 1] = EMPTY };
+static int page_count[HASH_SIZE];
+static uint64_t page_map[HASH_SIZE][PAGE_SIZE / 2 / 64];
+
+static inline uint32_t hash(vaddr_t key) {
+  return (uint32_t)(((uint64_t)key * 0x9e3779b97f4a7c15ull) >> (64 - HASH_BITS));
+}
+
+// return the slot of `key', or the first free slot on its probe sequence
+static int probe(vaddr_t *table, vaddr_t key, bool *found) {
+  int slot = -1;
+  uint32_t i = hash(key);
+  for (int n = 0; n < HASH_SIZE; n ++, i = (i + 1) & (HASH_SIZE - 1)) {
+    if (table[i] == key) { *found = true; return i; }
+    if (table[i] == EMPTY) { if (slot < 0) slot = i; break; }
+    if (table[i] == TOMB && slot < 0) slot = i;
+  }
+  *found = false;
+  return slot;
+}
+
+bool bp_find(vaddr_t pc) {
+  bool found;
+  probe(bp_table, pc, &found);
+  return found;
+}
+
+const uint64_t* bp_page_map(vaddr_t pc) {
+  bool found;
+  int i = probe(page_table, pc >> PAGE_SHIFT, &found);
+  return (found ? page_map[i] : NULL);
+}
+
+bool bp_insert(vaddr_t pc) {
+  bool found;
+  if (nr_bp >= MAX_BP) return false;
+  int i = probe(bp_table, pc, &found);
+  if (found) return false;
+  bp_table[i] = pc;
+  nr_bp ++;
+
+  vaddr_t page = pc >> PAGE_SHIFT;
+  i = probe(page_table, page, &found);
+  if (!found) { page_table[i] = page; page_count[i] = 0; }
+  page_count[i] ++;
+  page_map[i][BP_MAP_BIT(pc) / 64] |= 1ull << (BP_MAP_BIT(pc) % 64);
+  return true;
+}
+
+bool bp_remove(vaddr_t pc) {
+  bool found;
+  int i = probe(bp_table, pc, &found);
+  if (!found) return false;
+  bp_table[i] = TOMB;
+  nr_bp --;
+
+  i = probe(page_table, pc >> PAGE_SHIFT, &found);
+  assert(found);
+  page_map[i][BP_MAP_BIT(pc) / 64] &= ~(1ull << (BP_MAP_BIT(pc) % 64));
+  if (-- page_count[i] == 0) page_table[i] = TOMB;
+
+  if (nr_bp == 0) {
+    // sweep the tombstones, since debuggers remove and insert all breakpoints at every stop
+    for (i = 0; i < HASH_SIZE; i ++) bp_table[i] = page_table[i] = EMPTY;
+  }
+  return true;
+}
+
+#define MAX_MW 16
+
+int nr_mw = 0;
+bool mw_hit = false;
+vaddr_t mw_hit_addr = 0;
+int mw_hit_type = 0;
+
+static struct {
+  vaddr_t addr;
+  int len, type;
+} mw_pool[MAX_MW];
+
+bool mw_insert(vaddr_t addr, int len, int type) {
+  if (nr_mw >= MAX_MW || len <= 0) return false;
+  mw_pool[nr_mw].addr = addr;
+  mw_pool[nr_mw].len = len;
+  mw_pool[nr_mw].type = type;
+  nr_mw ++;
+  return true;
+}
+
+bool mw_remove(vaddr_t addr, int len, int type) {
+  for (int i = 0; i < nr_mw; i ++) {
+    if (mw_pool[i].addr == addr && mw_pool[i].len == len && mw_pool[i].type == type) {
+      mw_pool[i] = mw_pool[-- nr_mw];
+      return true;
+    }
+  }
+  return false;
+}
+
+void mw_check(vaddr_t addr, int len, int type) {
+  for (int i = 0; i < nr_mw; i ++) {
+    if ((mw_pool[i].type & type) && addr < mw_pool[i].addr + mw_pool[i].len && mw_pool[i].addr < addr + len) {
+      mw_hit = true;
+      mw_hit_addr = mw_pool[i].addr;
+      mw_hit_type = mw_pool[i].type;
+      if (nemu_state.state == NEMU_RUNNING) nemu_state.state = NEMU_STOP;
+      return;
+    }
+  }
+}
+#endif
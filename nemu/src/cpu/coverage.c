@@ -0,0 +1,88 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <cpu/cpu.h>
+#include <cpu/coverage.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef CONFIG_COVERAGE
+
+/* Bit i of the map is set when a basic block starts at
+ * CONFIG_MBASE + (i << COV_SHIFT). With --coverage=FILE, the map is FILE
+ * itself mapped with MAP_SHARED, so an external fuzzer can mmap FILE to
+ * watch and clear it. The bits accumulate over runs until FILE is deleted.
+ */
+
+uint8_t *cov_map = NULL;
+static const char *cov_file = NULL;
+
+void init_coverage(const char *file) {
+  cov_file = file;
+  if (file != NULL) {
+    int fd = open(file, O_RDWR | O_CREAT, 0644);
+    Assert(fd >= 0, "Can not open '%s'", file);
+    Assert(ftruncate(fd, COV_MAP_SIZE) == 0, "Can not resize '%s'", file);
+    cov_map = mmap(NULL, COV_MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+  } else {
+    cov_map = mmap(NULL, COV_MAP_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  }
+  Assert(cov_map != MAP_FAILED, "Can not map the coverage bitmap");
+  Log("Coverage: %s, one bit per %d bytes of pmem%s%s", ANSI_FMT("ON", ANSI_FG_GREEN),
+      1 << COV_SHIFT, (file ? ", mapped to " : ""), (file ? file : ""));
+}
+
+/* the list of covered blocks "address function", one per line, e.g.
+ *   cut -d' ' -f1 FILE.txt | addr2line -f -e ELF
+ */
+void coverage_report() {
+  FILE *fp = NULL;
+  char txt_file[cov_file ? strlen(cov_file) + 5 : 1];
+  if (cov_file != NULL) {
+    msync(cov_map, COV_MAP_SIZE, MS_SYNC);
+    sprintf(txt_file, "%s.txt", cov_file);
+    fp = fopen(txt_file, "w");
+    Assert(fp, "Can not open '%s'", txt_file);
+  }
+
+  bool func_hit[func_table != NULL ? func_table_size : 1];
+  memset(func_hit, 0, sizeof(func_hit));
+  uint64_t nr_block = 0;
+  int nr_func = 0;
+  const uint64_t *map = (const uint64_t *)cov_map;
+  for (size_t i = 0; i < COV_MAP_SIZE / 8; i ++) {
+    for (uint64_t w = map[i]; w != 0; w &= w - 1) {
+      vaddr_t pc = CONFIG_MBASE + ((i * 64 + __builtin_ctzll(w)) << COV_SHIFT);
+      nr_block ++;
+      int func = (func_table != NULL ? find_func_name(pc) : -1);
+      if (func >= 0 && func < func_table_size - 1 && !func_hit[func]) {
+        func_hit[func] = true;
+        nr_func ++;
+      }
+      if (fp != NULL) fprintf(fp, FMT_WORD " %s\n", pc, (func >= 0 ? func_table[func].func_name : "???"));
+    }
+  }
+
+  if (fp != NULL) {
+    fclose(fp);
+    Log("Coverage: the bitmap is %s, the covered blocks are listed in %s", cov_file, txt_file);
+  }
+  Log("Coverage: %" PRIu64 " basic blocks are entered", nr_block);
+  if (func_table != NULL) Log("Coverage: %d of %d functions are entered", nr_func, (int)func_table_size - 1);
+}
+#endif
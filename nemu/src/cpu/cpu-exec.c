@@ -16,6 +16,14 @@
 #include <cpu/cpu.h>
 #include <cpu/decode.h>
 #include <cpu/difftest.h>
+#include <cpu/stats.h>
+#include <memory/cache.h>
+#include <cpu/bpred.h>
+#include <plugin.h>
+#include <cpu/breakpoint.h>
+#include <cpu/coverage.h>
+#include <cpu/event.h>
+#include <memory/vaddr.h>
 #include <locale.h>
 
 /* The assembly code of instructions executed is only output to the screen
@@ -29,15 +37,12 @@
 #endif
 
 extern void wp_difftest();
-extern struct func_info *func_table;
-extern size_t func_table_size;
 
-CPU_state cpu = {};
-uint64_t g_nr_guest_inst = 0;
-static uint64_t g_timer = 0; // unit: us
-static bool g_print_step = false;
-static struct ret_info *ret_list = NULL;
-static int func_call_depth = 0;
+#define ret_list        (g_machine->ret_list)
+#define func_call_depth (g_machine->func_call_depth)
+#define g_timer         (g_machine->timer_us) // unit: us
+
+static MACHINE_TLS bool g_print_step = false;
 
 #ifdef CONFIG_ITRACE
 struct ibuf {
@@ -47,6 +52,7 @@ size_t g_iringbuf_idx = -1;
 #endif
 
 void device_update();
+void device_flush();
 
 #ifdef CONFIG_ITRACE
 static void trace_iringbuf(Decode *_this) {
@@ -96,28 +102,109 @@ static void exec_once(Decode *s, vaddr_t pc) {
 #endif
 }
 
+#ifdef CONFIG_BREAKPOINT
+// out of line to keep execute() tight
+static __attribute__((noinline)) const uint64_t* bp_enter_page(vaddr_t *page) {
+  *page = cpu.pc >> PAGE_SHIFT;
+  return bp_page_map(cpu.pc);
+}
+#endif
+
+#ifdef CONFIG_PROFILE
+static MACHINE_TLS int profile_countdown = CONFIG_PROFILE_PERIOD;
+#endif
+
+#ifdef CONFIG_PLUGIN
+static MACHINE_TLS bool block_start = true;
+#endif
+
+#ifdef CONFIG_BBV
+// the current basic block
+static MACHINE_TLS vaddr_t bbv_pc = 0;
+static MACHINE_TLS uint32_t bbv_len = 0;
+#endif
+
 static void execute(uint64_t n) {
   Decode s;
-  for (;n > 0; n --) {
+#ifdef CONFIG_BREAKPOINT
+  // the breakpoints of page `bp_page'; the instruction at the current pc
+  // is never stopped at, so we can resume from a breakpoint
+  vaddr_t bp_page = -1;
+  const uint64_t *bp_map = NULL;
+#endif
+  if (n == 0) return;
+  // stop at `end', and dispatch the events due until then
+  uint64_t end = (n > UINT64_MAX - g_nr_guest_inst ? UINT64_MAX : g_nr_guest_inst + n);
+  uint64_t next = event_deadline();
+  g_machine->deadline = (end < next ? end : next);
+  IFDEF(CONFIG_COVERAGE, cov_mark(cpu.pc));
+  while (true) {
+#ifdef CONFIG_PLUGIN
+    if (PLUGIN_ON(PLUGIN_BLOCK) && block_start) plugin_block(cpu.pc);
+#endif
     exec_once(&s, cpu.pc);
     g_nr_guest_inst ++;
+#ifdef CONFIG_PLUGIN
+    block_start = (s.dnpc != s.snpc);
+    if (PLUGIN_ON(PLUGIN_INSN)) plugin_insn(s.pc, s.isa.inst.val);
+#endif
+#ifdef CONFIG_COVERAGE
+    // the ISA marks the fall-through of a branch not taken
+    if (s.dnpc != s.snpc) cov_mark(s.dnpc);
+#endif
+#ifdef CONFIG_BBV
+    if (bbv_len ++ == 0) bbv_pc = s.pc;
+    if (s.dnpc != s.snpc) {
+      bbv_block(bbv_pc, bbv_len);
+      bbv_len = 0;
+    }
+#endif
+#ifdef CONFIG_PROFILE
+    if (unlikely(-- profile_countdown == 0)) {
+      profile_countdown = CONFIG_PROFILE_PERIOD;
+      profile_sample(cpu.pc);
+    }
+#endif
     IFDEF(CONFIG_ITRACE, trace_iringbuf(&s));
     trace_and_difftest(&s, cpu.pc);
     if (nemu_state.state != NEMU_RUNNING) break;
-    IFDEF(CONFIG_DEVICE, device_update());
+    IFDEF(CONFIG_DEVICE, if (likely(!g_machine->headless)) device_update());
+#ifdef CONFIG_BREAKPOINT
+    if (unlikely(nr_bp != 0)) {
+      // a compare per instruction, which is cheaper than finding out whether
+      // a block begins, as a block also begins when the pc crosses a page
+      if (unlikely((cpu.pc >> PAGE_SHIFT) != bp_page)) bp_map = bp_enter_page(&bp_page);
+      if (unlikely(bp_map != NULL) && bp_map_test(bp_map, cpu.pc)) {
+        bp_hit = true;
+        nemu_state.state = NEMU_STOP;
+        break;
+      }
+    }
+#endif
+    // the only check per instruction besides the state of NEMU
+    if (unlikely(g_nr_guest_inst >= g_machine->deadline)) {
+      // deliver the events due at `end' too, or stepping never sees them
+      event_dispatch();
+      if (g_nr_guest_inst >= end) break;
+      next = event_deadline();
+      g_machine->deadline = (end < next ? end : next);
+    }
   }
 }
 
-static void statistic() {
+void statistic() {
   IFNDEF(CONFIG_TARGET_AM, setlocale(LC_NUMERIC, ""));
 #define NUMBERIC_FMT MUXDEF(CONFIG_TARGET_AM, "%", "%'") PRIu64
   Log("host time spent = " NUMBERIC_FMT " us", g_timer);
   Log("total guest instructions = " NUMBERIC_FMT, g_nr_guest_inst);
   if (g_timer > 0) Log("simulation frequency = " NUMBERIC_FMT " inst/s", g_nr_guest_inst * 1000000 / g_timer);
   else Log("Finish running in less than 1 us and can not calculate the simulation frequency");
+  IFDEF(CONFIG_STATS, stats_display());
+  IFDEF(CONFIG_CACHESIM, cache_report());
 }
 
 void assert_fail_msg() {
+  IFDEF(CONFIG_DEVICE, device_flush());
   isa_reg_display();
   statistic();
 }
@@ -150,10 +237,17 @@ void cpu_exec(uint64_t n) {
   uint64_t timer_start = get_time();
 
   execute(n);
+  IFDEF(CONFIG_DEVICE, device_flush());
 
   uint64_t timer_end = get_time();
   g_timer += timer_end - timer_start;
 
+  // a machine of the C API only prints when asked by machine_report()
+  if (g_machine->headless) {
+    if (nemu_state.state == NEMU_RUNNING) nemu_state.state = NEMU_STOP;
+    return;
+  }
+
   switch (nemu_state.state) {
     case NEMU_RUNNING: nemu_state.state = NEMU_STOP; break;
 
@@ -167,8 +261,17 @@ void cpu_exec(uint64_t n) {
           nemu_state.halt_pc);
       // fall through
     case NEMU_QUIT:
+      IFDEF(CONFIG_PROFILE, profile_report());
+      IFDEF(CONFIG_COVERAGE, coverage_report());
+#ifdef CONFIG_BBV
+      if (bbv_len != 0) bbv_block(bbv_pc, bbv_len); // the block ending with the halt
+      bbv_report();
+#endif
+      IFDEF(CONFIG_BPRED, bpred_report());
+      IFDEF(CONFIG_PLUGIN, if (PLUGIN_ON(PLUGIN_EXIT)) plugin_exit());
       if (func_table != NULL) {
         free(func_table);
+        func_table = NULL;
       }
       statistic();
   }
@@ -200,7 +303,7 @@ void func_trace_ret(vaddr_t pc) {
   int idx = find_func_name(pc);
   _Log("0x%08lx:%*s ret  [%s]\n", pc, func_call_depth, "", func_table[idx].func_name);
   
-  struct ret_info *node = ret_list->next;
+  struct ret_info *node = (ret_list != NULL ? ret_list->next : NULL);
   if (node != NULL && node->depth == func_call_depth) {
     vaddr_t tmp_addr = node->addr;
     ret_list_remove();
@@ -239,14 +342,22 @@ void ret_list_remove() {
   }
 }
 
+/* func_table is sorted by func_start, and the last entry is "???". This
+ * is called for every branch by some tools, so remember the last hit. */
 int find_func_name(vaddr_t addr) {
-  size_t idx = 0;
+  static MACHINE_TLS size_t last = 0;
+  if (last < func_table_size - 1 &&
+      addr >= func_table[last].func_start && addr < func_table[last].func_end) {
+    return last;
+  }
 
-  for(; idx < func_table_size - 1; idx++) {
-    if (addr >= func_table[idx].func_start && addr < func_table[idx].func_end) {
-      return idx;
-    }
+  size_t lo = 0, hi = func_table_size - 1;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (addr < func_table[mid].func_start) hi = mid;
+    else if (addr >= func_table[mid].func_end) lo = mid + 1;
+    else return (last = mid);
   }
 
-  return idx;
+  return func_table_size - 1;
 }
@@ -140,6 +140,18 @@ void difftest_attach() {
   ref_difftest_memcpy(RESET_VECTOR, guest_to_host(RESET_VECTOR), CONFIG_MSIZE, DIFFTEST_TO_REF);
   ref_difftest_regcpy(&cpu, DIFFTEST_TO_REF);
 }
+
+// push the memory written behind the back of the reference to it
+void difftest_sync_mem(paddr_t addr, size_t n) {
+  if (difftest_tag == false || n == 0) return;
+  ref_difftest_memcpy(addr, guest_to_host(addr), n, DIFFTEST_TO_REF);
+}
+
+// an interrupt taken by DUT, which REF never sees by itself
+void difftest_sync_intr(word_t NO) {
+  if (difftest_tag == false) return;
+  ref_difftest_raise_intr(NO);
+}
 #else
 void init_difftest(char *ref_so_file, long img_size, int port) { }
 #endif
@@ -0,0 +1,73 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <cpu/event.h>
+#include <cpu/difftest.h>
+
+#define events   (g_machine->events)
+#define nr_event (g_machine->nr_event)
+
+int event_add(event_handler_t handler) {
+  Assert(nr_event < NR_EVENT, "too many events");
+  events[nr_event] = (Event) { .when = UINT64_MAX, .handler = handler };
+  return nr_event ++;
+}
+
+// the instruction count when the next event is due
+uint64_t event_deadline() {
+  uint64_t next = g_machine->next_event;
+  return (next == UINT64_MAX ? next : next > g_machine->idle_ticks ? next - g_machine->idle_ticks : 0);
+}
+
+void event_set(int id, uint64_t when) {
+  events[id].when = when;
+  // a later deadline is found by the next dispatch
+  if (when < g_machine->next_event) {
+    g_machine->next_event = when;
+    uint64_t deadline = event_deadline();
+    if (deadline < g_machine->deadline) g_machine->deadline = deadline;
+  }
+}
+
+// nothing happens before the next event, skip to it
+void event_idle() {
+  uint64_t now = vtime();
+  if (g_machine->next_event != UINT64_MAX && g_machine->next_event > now) {
+    g_machine->idle_ticks += g_machine->next_event - now;
+  }
+  event_kick();
+}
+
+void event_dispatch() {
+  for (int i = 0; i < nr_event; i ++) {
+    if (events[i].when <= vtime()) {
+      events[i].when = UINT64_MAX;
+      events[i].handler();
+    }
+  }
+  // the handlers may schedule events
+  uint64_t next = UINT64_MAX;
+  for (int i = 0; i < nr_event; i ++) {
+    if (events[i].when < next) next = events[i].when;
+  }
+  g_machine->next_event = next;
+
+  word_t intr = isa_query_intr();
+  if (intr != INTR_EMPTY) {
+    cpu.pc = isa_raise_intr(intr, cpu.pc);
+    difftest_sync_intr(intr);
+  }
+}
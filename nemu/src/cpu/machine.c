@@ -0,0 +1,104 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <machine.h>
+#include <cpu/cpu.h>
+#include <memory/paddr.h>
+#include <difftest-def.h>
+
+void init_mem();
+void free_mem();
+
+// the machine set up by the monitor
+static Machine default_machine = { .state = { .state = NEMU_STOP } };
+MACHINE_TLS Machine *g_machine = &default_machine;
+
+// the first feature enabled whose state is global instead of in Machine
+static const char* global_feature() {
+  IFDEF(CONFIG_ITRACE, return "ITRACE");
+  IFDEF(CONFIG_DIFFTEST, return "DIFFTEST");
+  IFDEF(CONFIG_BREAKPOINT, return "BREAKPOINT");
+  IFDEF(CONFIG_PROFILE, return "PROFILE");
+  IFDEF(CONFIG_STATS, return "STATS");
+  IFDEF(CONFIG_CACHESIM, return "CACHESIM");
+  IFDEF(CONFIG_BPRED, return "BPRED");
+  IFDEF(CONFIG_PLUGIN, return "PLUGIN");
+  IFDEF(CONFIG_BBV, return "BBV");
+  IFDEF(CONFIG_COVERAGE, return "COVERAGE");
+  return NULL;
+}
+
+__EXPORT Machine* machine_create() {
+  const char *feature = global_feature();
+  if (feature != NULL) {
+    Log("Can not create machines with CONFIG_%s, whose state is shared by all machines", feature);
+    return NULL;
+  }
+
+  Machine *m = calloc(1, sizeof(Machine));
+  assert(m);
+  m->state.state = NEMU_STOP;
+  m->headless = true;
+
+  Machine *prev = g_machine;
+  g_machine = m;
+  init_mem();
+  init_isa();
+  g_machine = prev;
+  return m;
+}
+
+__EXPORT void machine_destroy(Machine *m) {
+  Assert(m != &default_machine, "can not destroy the default machine");
+
+  Machine *prev = g_machine;
+  g_machine = m;
+  free_mem();
+  free(func_table);
+  g_machine = prev;
+
+  while (m->ret_list != NULL) {
+    struct ret_info *next = m->ret_list->next;
+    free(m->ret_list);
+    m->ret_list = next;
+  }
+  free(m->wp_pool);
+  free(m->io_space);
+  free(m);
+}
+
+__EXPORT void machine_load(Machine *m, const void *img, size_t size) {
+  Assert(size <= CONFIG_MSIZE - CONFIG_PC_RESET_OFFSET, "image is too large, size = %zu", size);
+  memcpy(m->pmem + CONFIG_PC_RESET_OFFSET, img, size);
+}
+
+__EXPORT int machine_run(Machine *m, uint64_t n) {
+  Machine *prev = g_machine;
+  g_machine = m;
+  cpu_exec(n);
+  g_machine = prev;
+  return m->state.state;
+}
+
+__EXPORT int machine_step(Machine *m) {
+  return machine_run(m, 1);
+}
+
+__EXPORT void machine_report(Machine *m) {
+  Machine *prev = g_machine;
+  g_machine = m;
+  statistic();
+  g_machine = prev;
+}
@@ -0,0 +1,137 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <cpu/cpu.h>
+
+#ifdef CONFIG_PROFILE
+
+#define MAX_DEPTH 256
+
+/* A node of the calling context tree. The shadow stack holds the path
+ * from the root to the current context, so a call is a child lookup and
+ * a sample is a counter increment.
+ */
+typedef struct context {
+  int func;          // index in func_table
+  uint64_t samples;  // samples taken while this context is on the top
+  struct context *child, *sibling;
+} Context;
+
+static Context root = { .func = -1 };
+static Context *stack[MAX_DEPTH] = { &root };
+static int depth = 0;  // stack[depth] is the current context
+static int lost = 0;   // frames deeper than MAX_DEPTH
+static uint64_t *flat = NULL;  // self samples of each function
+static uint64_t nr_sample = 0;
+static const char *folded_file = NULL;
+
+static Context* get_child(Context *p, int func) {
+  Context *c;
+  for (c = p->child; c != NULL; c = c->sibling) {
+    if (c->func == func) return c;
+  }
+  c = calloc(1, sizeof(Context));
+  assert(c);
+  c->func = func;
+  c->sibling = p->child;
+  p->child = c;
+  return c;
+}
+
+void init_profile(const char *file) {
+  folded_file = file;
+  if (func_table == NULL) {
+    Log("Profiler: no symbol table, please give the ELF file with --elf");
+    return;
+  }
+  flat = calloc(func_table_size, sizeof(uint64_t));
+  assert(flat);
+  Log("Profiler: %s, sampling every %d instructions", ANSI_FMT("ON", ANSI_FG_GREEN), CONFIG_PROFILE_PERIOD);
+}
+
+void profile_call(vaddr_t pc, vaddr_t target, bool tail_call) {
+  if (flat == NULL) return;
+  // a jump inside the function, e.g. a loop or a jump table
+  if (tail_call && find_func_name(target) == find_func_name(pc)) return;
+  if (tail_call) {
+    // the callee will return to our caller
+    if (lost > 0) return;
+    if (depth > 0) depth --;
+  }
+  if (depth == MAX_DEPTH - 1) { lost ++; return; }
+  stack[depth + 1] = get_child(stack[depth], find_func_name(target));
+  depth ++;
+}
+
+void profile_ret() {
+  if (flat == NULL) return;
+  if (lost > 0) lost --;
+  else if (depth > 0) depth --;
+}
+
+void profile_sample(vaddr_t pc) {
+  if (flat == NULL) return;
+  int func = find_func_name(pc);
+  Context *c = stack[depth];
+  // we may be in a function which is not entered by a call, e.g. _start
+  if (c->func != func) c = get_child(c, func);
+  c->samples ++;
+  flat[func] ++;
+  nr_sample ++;
+}
+
+/* one line per calling context: "f0;f1;f2 samples",
+ * which is understood by flamegraph.pl and speedscope */
+static void dump_folded(FILE *fp, Context *c, char *path, int len) {
+  if (c != &root) {
+    int n = snprintf(path + len, MAX_DEPTH * 4 - len, "%s%s",
+        (len == 0 ? "" : ";"), func_table[c->func].func_name);
+    len = (len + n < MAX_DEPTH * 4 ? len + n : MAX_DEPTH * 4 - 1);
+    if (c->samples != 0) fprintf(fp, "%s %" PRIu64 "\n", path, c->samples);
+  }
+  for (Context *p = c->child; p != NULL; p = p->sibling) {
+    dump_folded(fp, p, path, len);
+  }
+}
+
+static int cmp_flat(const void *a, const void *b) {
+  uint64_t x = flat[*(const int *)a], y = flat[*(const int *)b];
+  return (x < y) - (x > y);
+}
+
+void profile_report() {
+  if (flat == NULL || nr_sample == 0) return;
+
+  if (folded_file != NULL) {
+    FILE *fp = fopen(folded_file, "w");
+    Assert(fp, "Can not open '%s'", folded_file);
+    static char path[MAX_DEPTH * 4];
+    dump_folded(fp, &root, path, 0);
+    fclose(fp);
+    Log("Profiler: folded stacks are written to %s", folded_file);
+  }
+
+  int idx[func_table_size];
+  for (int i = 0; i < func_table_size; i ++) idx[i] = i;
+  qsort(idx, func_table_size, sizeof(int), cmp_flat);
+
+  Log("Profiler: %" PRIu64 " samples, top functions by self samples:", nr_sample);
+  for (int i = 0; i < CONFIG_PROFILE_TOP && i < func_table_size && flat[idx[i]] != 0; i ++) {
+    Log("%6.2f%% %10" PRIu64 "  %s", flat[idx[i]] * 100.0 / nr_sample, flat[idx[i]],
+        func_table[idx[i]].func_name);
+  }
+}
+#endif
@@ -0,0 +1,98 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <cpu/stats.h>
+
+#ifdef CONFIG_STATS
+Stats g_stats = {};
+static InstStat *inst_list = NULL;
+static int nr_inst_stat = 0;
+
+void stats_register(InstStat *st) {
+  st->next = inst_list;
+  inst_list = st;
+  nr_inst_stat ++;
+}
+
+static int cmp_count(const void *a, const void *b) {
+  uint64_t x = (*(InstStat **)a)->count, y = (*(InstStat **)b)->count;
+  return (x < y) - (x > y);
+}
+
+static double percent(uint64_t x, uint64_t total) {
+  return (total == 0 ? 0 : x * 100.0 / total);
+}
+
+// sort the mnemonics by count, return the total count
+static uint64_t sort_inst(InstStat **inst) {
+  uint64_t total = 0;
+  int i = 0;
+  for (InstStat *p = inst_list; p != NULL; p = p->next) {
+    inst[i ++] = p;
+    total += p->count;
+  }
+  qsort(inst, nr_inst_stat, sizeof(inst[0]), cmp_count);
+  return total;
+}
+
+void stats_display() {
+  InstStat *inst[nr_inst_stat];
+  uint64_t total = sort_inst(inst);
+  int i;
+
+  printf("instruction mix (%" PRIu64 " instructions):\n", total);
+  for (i = 0; i < nr_inst_stat; i ++) {
+    printf("  %-8s %15" PRIu64 " %6.2f%%\n", inst[i]->name, inst[i]->count, percent(inst[i]->count, total));
+  }
+
+  uint64_t nr_load = 0, nr_store = 0;
+  for (i = 0; i < 4; i ++) {
+    nr_load += g_stats.load[i];
+    nr_store += g_stats.store[i];
+  }
+  printf("memory access:\n");
+  printf("  %-8s %15s %15s\n", "width", "load", "store");
+  for (i = 0; i < 4; i ++) {
+    printf("  %-8d %15" PRIu64 " %15" PRIu64 "\n", 1 << i, g_stats.load[i], g_stats.store[i]);
+  }
+  printf("  %-8s %15" PRIu64 " %15" PRIu64 "\n", "total", nr_load, nr_store);
+  printf("  pmem %" PRIu64 " (%.2f%%), mmio %" PRIu64 " (%.2f%%)\n",
+      g_stats.pmem, percent(g_stats.pmem, nr_load + nr_store),
+      g_stats.mmio, percent(g_stats.mmio, nr_load + nr_store));
+
+  uint64_t nr_branch = g_stats.branch[0] + g_stats.branch[1];
+  printf("conditional branch: %" PRIu64 ", taken %" PRIu64 " (%.2f%%), not taken %" PRIu64 " (%.2f%%)\n",
+      nr_branch, g_stats.branch[1], percent(g_stats.branch[1], nr_branch),
+      g_stats.branch[0], percent(g_stats.branch[0], nr_branch));
+}
+
+// the same as stats_display(), as the fields of a JSON object
+void stats_json(FILE *fp) {
+  InstStat *inst[nr_inst_stat];
+  sort_inst(inst);
+  int i;
+
+  fputs(",\"stats\":{\"insts\":[", fp);
+  for (i = 0; i < nr_inst_stat; i ++) {
+    fprintf(fp, "%s{\"name\":\"%s\",\"count\":%" PRIu64 "}", (i == 0 ? "" : ","), inst[i]->name, inst[i]->count);
+  }
+  fputs("],\"load\":[", fp);
+  for (i = 0; i < 4; i ++) fprintf(fp, "%s%" PRIu64, (i == 0 ? "" : ","), g_stats.load[i]);
+  fputs("],\"store\":[", fp);
+  for (i = 0; i < 4; i ++) fprintf(fp, "%s%" PRIu64, (i == 0 ? "" : ","), g_stats.store[i]);
+  fprintf(fp, "],\"pmem\":%" PRIu64 ",\"mmio\":%" PRIu64 ",\"taken\":%" PRIu64 ",\"not_taken\":%" PRIu64 "}",
+      g_stats.pmem, g_stats.mmio, g_stats.branch[1], g_stats.branch[0]);
+}
+#endif
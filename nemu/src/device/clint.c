@@ -0,0 +1,72 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <machine.h>
+#include <cpu/event.h>
+
+/* The core local interruptor of riscv. mtime is the virtual time, which
+ * ticks once per instruction like the `time' CSR and skips forward while
+ * the hart waits in `wfi', so the timer interrupt arrives at the same
+ * instruction in every run. The deadline mtimecmp is an event, so nothing
+ * is checked per instruction.
+ */
+
+#define MIP_MSIP (1ul << 3)
+#define MIP_MTIP (1ul << 7)
+
+static uint32_t *msip = NULL;
+static uint64_t *mtimecmp = NULL, *mtime = NULL;
+static int timer_event = -1;
+
+static void timer_fire() {
+  cpu.mip |= MIP_MTIP;
+}
+
+static void msip_io_handler(uint32_t offset, int len, bool is_write) {
+  if (is_write) {
+    *msip &= 1;
+    if (*msip) cpu.mip |= MIP_MSIP;
+    else cpu.mip &= ~MIP_MSIP;
+    event_kick();
+  }
+}
+
+static void mtimecmp_io_handler(uint32_t offset, int len, bool is_write) {
+  if (is_write) {
+    if (vtime() >= *mtimecmp) cpu.mip |= MIP_MTIP;
+    else {
+      cpu.mip &= ~MIP_MTIP;
+      event_set(timer_event, *mtimecmp);
+    }
+    event_kick();
+  }
+}
+
+static void mtime_io_handler(uint32_t offset, int len, bool is_write) {
+  // mtime can not be written
+  *mtime = vtime();
+}
+
+void init_clint() {
+  msip = (uint32_t *)new_space(4);
+  mtimecmp = (uint64_t *)new_space(8);
+  mtime = (uint64_t *)new_space(8);
+  *msip = 0;
+  *mtimecmp = UINT64_MAX;
+  add_mmio_map("clint-msip", CONFIG_CLINT_MMIO, msip, 4, msip_io_handler);
+  add_mmio_map("clint-mtimecmp", CONFIG_CLINT_MMIO + 0x4000, mtimecmp, 8, mtimecmp_io_handler);
+  add_mmio_map("clint-mtime", CONFIG_CLINT_MMIO + 0xbff8, mtime, 8, mtime_io_handler);
+  timer_event = event_add(timer_fire);
+}
@@ -15,6 +15,7 @@
 
 #include <common.h>
 #include <utils.h>
+#include <machine.h>
 #include <device/alarm.h>
 #ifndef CONFIG_TARGET_AM
 #include <SDL2/SDL.h>
@@ -22,7 +23,9 @@
 
 void init_map();
 void init_serial();
+void serial_flush();
 void init_timer();
+void init_clint();
 void init_vga();
 void init_i8042();
 void init_audio();
@@ -41,6 +44,7 @@ void device_update() {
   }
   last = now;
 
+  IFDEF(CONFIG_HAS_SERIAL, serial_flush());
   IFDEF(CONFIG_HAS_VGA, vga_update_screen());
 
 #ifndef CONFIG_TARGET_AM
@@ -66,6 +70,11 @@ void device_update() {
 #endif
 }
 
+// called when the CPU stops, so that the output is not held back
+void device_flush() {
+  IFDEF(CONFIG_HAS_SERIAL, serial_flush());
+}
+
 void sdl_clear_event_queue() {
 #ifndef CONFIG_TARGET_AM
   SDL_Event event;
@@ -79,6 +88,7 @@ void init_device() {
 
   IFDEF(CONFIG_HAS_SERIAL, init_serial());
   IFDEF(CONFIG_HAS_TIMER, init_timer());
+  IFDEF(CONFIG_HAS_CLINT, init_clint());
   IFDEF(CONFIG_HAS_VGA, init_vga());
   IFDEF(CONFIG_HAS_KEYBOARD, init_i8042());
   IFDEF(CONFIG_HAS_AUDIO, init_audio());
@@ -13,7 +13,138 @@
 * See the Mulan PSL v2 for more details.
 ***************************************************************************************/
 
+#include <machine.h>
 #include <device/map.h>
+#include <memory/paddr.h>
+#include <stddef.h>
+#ifndef CONFIG_TARGET_AM
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* A block device in the style of virtio. The driver puts requests into a
+ * ring of descriptors in guest memory and writes the number of requests
+ * it has made so far to reg_avail. The device then serves all of them by
+ * memcpy() between pmem and the image mapped into the host memory, writes
+ * the number of served requests to reg_used and sets reg_intr, which the
+ * driver may poll or ask to be raised as an interrupt with reg_intr_en.
+ * The interrupt is the machine external interrupt of riscv, pending while
+ * both reg_intr and reg_intr_en are set, and is not supported elsewhere.
+ */
+
+#define BLKSZ 512
+#define MIP_MEIP (1ul << 11)
+
+enum {
+  reg_blksz,
+  reg_blkcnt,
+  reg_queue_addr,  // guest physical address of the descriptor ring
+  reg_queue_size,  // number of descriptors, a power of 2
+  reg_avail,       // written by the driver
+  reg_used,        // written by the device
+  reg_intr,        // set when requests are served, write to clear
+  reg_intr_en,
+  nr_reg
+};
+
+typedef struct {
+  uint32_t write;   // 0: disk to buf, 1: buf to disk
+  uint32_t blkno;
+  uint32_t blkcnt;
+  uint32_t buf;     // guest physical address
+  uint32_t status;  // set by the device, 0 on success
+} DiskDesc;
+
+static uint32_t *disk_base = NULL;
+static uint8_t *img = NULL;
+
+static bool pmem_range(paddr_t addr, uint64_t len) {
+  return in_pmem(addr) && len <= CONFIG_MSIZE - (addr - CONFIG_MBASE);
+}
+
+static uint32_t disk_rw(DiskDesc *d) {
+  if (img == NULL || d->blkno > disk_base[reg_blkcnt] ||
+      d->blkcnt > disk_base[reg_blkcnt] - d->blkno) return 1;
+  uint64_t len = (uint64_t)d->blkcnt * BLKSZ;
+  if (len == 0) return 0;
+  if (!pmem_range(d->buf, len)) return 1;
+  uint8_t *disk = img + (uint64_t)d->blkno * BLKSZ;
+  uint8_t *mem = guest_to_host(d->buf);
+  if (d->write) memcpy(disk, mem, len);
+  else memcpy(mem, disk, len);
+  paddr_dma(d->buf, len, !d->write);
+  return 0;
+}
+
+static void disk_update_intr() {
+#ifdef CONFIG_ISA_riscv
+  if (disk_base[reg_intr] && disk_base[reg_intr_en]) cpu.mip |= MIP_MEIP;
+  else cpu.mip &= ~MIP_MEIP;
+  event_kick();
+#endif
+}
+
+static void disk_serve() {
+  uint32_t size = disk_base[reg_queue_size];
+  Assert(size != 0 && (size & (size - 1)) == 0, "disk: bad queue size %d", size);
+  // a batch of requests is completed with a single update of reg_used
+  uint32_t used = disk_base[reg_used];
+  for (; used != disk_base[reg_avail]; used ++) {
+    paddr_t addr = disk_base[reg_queue_addr] + (used & (size - 1)) * sizeof(DiskDesc);
+    Assert(pmem_range(addr, sizeof(DiskDesc)), "disk: descriptor out of pmem at " FMT_PADDR, addr);
+    DiskDesc *d = (DiskDesc *)guest_to_host(addr);
+    paddr_dma(addr, sizeof(DiskDesc), false);
+    d->status = disk_rw(d);
+    paddr_dma(addr + offsetof(DiskDesc, status), sizeof(d->status), true);
+  }
+  disk_base[reg_used] = used;
+  disk_base[reg_intr] = 1;
+  disk_update_intr();
+}
+
+static void disk_io_handler(uint32_t offset, int len, bool is_write) {
+  if (!is_write) return;
+  switch (offset / sizeof(uint32_t)) {
+    case reg_avail: disk_serve(); break;
+    case reg_intr: disk_base[reg_intr] = 0; disk_update_intr(); break;
+    case reg_intr_en: disk_update_intr(); break;
+    case reg_queue_addr: case reg_queue_size: break;
+    default: panic("disk: register %d is read-only", offset);
+  }
+}
+
+static void load_img() {
+#ifndef CONFIG_TARGET_AM
+  const char *path = CONFIG_DISK_IMG_PATH;
+  if (path[0] == '\0') return;
+  int fd = open(path, O_RDWR);
+  if (fd < 0) { Log("Can not find disk image: %s", path); return; }
+  struct stat st;
+  Assert(fstat(fd, &st) == 0, "Can not stat '%s'", path);
+  uint64_t nr_blk = st.st_size / BLKSZ;
+  if (nr_blk > UINT32_MAX) nr_blk = UINT32_MAX;
+  if (nr_blk != 0) {
+    // writes of the guest go to the image, and only pages touched are read
+    img = mmap(NULL, nr_blk * BLKSZ, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    Assert(img != MAP_FAILED, "Can not mmap '%s'", path);
+    disk_base[reg_blkcnt] = nr_blk;
+  }
+  close(fd);
+  Log("Disk image %s, %" PRIu64 " blocks", path, nr_blk);
+#endif
+}
 
 void init_disk() {
+  uint32_t space_size = sizeof(uint32_t) * nr_reg;
+  disk_base = (uint32_t *)new_space(space_size);
+  memset(disk_base, 0, space_size);
+  disk_base[reg_blksz] = BLKSZ;
+#ifdef CONFIG_HAS_PORT_IO
+  add_pio_map ("disk", CONFIG_DISK_CTL_PORT, disk_base, space_size, disk_io_handler);
+#else
+  add_mmio_map("disk", CONFIG_DISK_CTL_MMIO, disk_base, space_size, disk_io_handler);
+#endif
+  load_img();
 }
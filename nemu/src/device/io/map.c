@@ -20,8 +20,8 @@
 
 #define IO_SPACE_MAX (2 * 1024 * 1024)
 
-static uint8_t *io_space = NULL;
-static uint8_t *p_space = NULL;
+#define io_space (g_machine->io_space)
+#define p_space  (g_machine->p_space)
 
 #ifdef CONFIG_DTRACE
 static void display_dread(IOMap *map, paddr_t addr, int len) {
@@ -66,6 +66,7 @@ word_t map_read(paddr_t addr, int len, IOMap *map) {
   assert(len >= 1 && len <= 8);
   check_bound(map, addr);
   paddr_t offset = addr - map->low;
+  g_machine->nr_io ++;
   invoke_callback(map->callback, offset, len, false); // prepare data to read
   word_t ret = host_read(map->space + offset, len);
   IFDEF(CONFIG_DTRACE, display_dread(map, addr, len));
@@ -77,6 +78,7 @@ void map_write(paddr_t addr, int len, word_t data, IOMap *map) {
   check_bound(map, addr);
   paddr_t offset = addr - map->low;
   host_write(map->space + offset, len, data);
+  g_machine->nr_io ++;
   invoke_callback(map->callback, offset, len, true);
   IFDEF(CONFIG_DTRACE, display_dwrite(map, addr, len, data));
 }
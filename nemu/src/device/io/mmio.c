@@ -13,13 +13,11 @@
 * See the Mulan PSL v2 for more details.
 ***************************************************************************************/
 
-#include <device/map.h>
+#include <machine.h>
 #include <memory/paddr.h>
 
-#define NR_MAP 16
-
-static IOMap maps[NR_MAP] = {};
-static int nr_map = 0;
+#define maps   (g_machine->mmio_maps)
+#define nr_map (g_machine->nr_mmio_map)
 
 static IOMap* fetch_mmio_map(paddr_t addr) {
   int mapid = find_mapid_by_addr(maps, nr_map, addr);
@@ -13,8 +13,9 @@
 * See the Mulan PSL v2 for more details.
 ***************************************************************************************/
 
-#include <device/map.h>
+#include <machine.h>
 #include <utils.h>
+#include <device/replay.h>
 
 #define KEYDOWN_MASK 0x8000
 
@@ -85,7 +86,9 @@ static uint32_t *i8042_data_port_base = NULL;
 static void i8042_data_io_handler(uint32_t offset, int len, bool is_write) {
   assert(!is_write);
   assert(offset == 0);
-  i8042_data_port_base[0] = key_dequeue();
+  uint32_t key = key_dequeue();
+  IFDEF(CONFIG_RECORD_REPLAY, key = rr_input(RR_KEYBOARD, key));
+  i8042_data_port_base[0] = key;
 }
 
 void init_i8042() {
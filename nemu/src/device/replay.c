@@ -0,0 +1,133 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <machine.h>
+#include <device/replay.h>
+
+/* The log is a magic string followed by records of
+ *   uleb128(instruction count - that of the previous record), dev, uleb128(value - expected)
+ * where the expected value is the last one for RTC and 0 (no key) for the
+ * keyboard. Reads which return the expected value are not logged, so polling
+ * an idle keyboard costs nothing. The last record is RR_END with the number
+ * of instructions of the whole session.
+ */
+
+#define RR_MAGIC "NEMU-RR1"
+#define RR_END 0xff
+
+enum { RR_OFF, RR_RECORD, RR_REPLAY };
+
+static int mode = RR_OFF;
+static FILE *fp = NULL;
+static uint64_t last_inst = 0; // instruction count of the previous record
+static uint64_t expected[RR_NR_DEV] = {};
+
+// the next record to replay
+static uint64_t next_inst = 0, next_delta = 0;
+static int next_dev = RR_END;
+
+static void put_uleb(uint64_t x) {
+  do {
+    uint8_t b = x & 0x7f;
+    x >>= 7;
+    fputc(b | (x != 0 ? 0x80 : 0), fp);
+  } while (x != 0);
+}
+
+static bool get_uleb(uint64_t *x) {
+  *x = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    int c = fgetc(fp);
+    if (c == EOF) return false;
+    *x |= (uint64_t)(c & 0x7f) << shift;
+    if (!(c & 0x80)) return true;
+  }
+  return false;
+}
+
+static void read_next() {
+  uint64_t inst;
+  if (!get_uleb(&inst) || (next_dev = fgetc(fp)) == EOF ||
+      (next_dev != RR_END && (next_dev >= RR_NR_DEV || !get_uleb(&next_delta)))) {
+    // a truncated log, the session ends at the previous record
+    next_dev = RR_END;
+    next_inst = last_inst;
+    return;
+  }
+  next_inst = last_inst = last_inst + inst;
+}
+
+static void close_record() {
+  put_uleb(g_nr_guest_inst - last_inst);
+  fputc(RR_END, fp);
+  fclose(fp);
+}
+
+void init_replay(const char *record_file, const char *replay_file) {
+  Assert(record_file == NULL || replay_file == NULL, "can not record and replay at the same time");
+  char magic[sizeof(RR_MAGIC) - 1];
+  if (record_file != NULL) {
+    fp = fopen(record_file, "wb");
+    Assert(fp, "Can not open '%s'", record_file);
+    fwrite(RR_MAGIC, sizeof(magic), 1, fp);
+    atexit(close_record);
+    mode = RR_RECORD;
+    Log("Record the inputs of devices to %s", record_file);
+  } else if (replay_file != NULL) {
+    fp = fopen(replay_file, "rb");
+    Assert(fp, "Can not open '%s'", replay_file);
+    Assert(fread(magic, sizeof(magic), 1, fp) == 1 && memcmp(magic, RR_MAGIC, sizeof(magic)) == 0,
+        "%s is not a log of recorded inputs", replay_file);
+    read_next();
+    mode = RR_REPLAY;
+    Log("Replay the inputs of devices from %s", replay_file);
+  }
+}
+
+bool rr_replaying() {
+  return mode == RR_REPLAY;
+}
+
+uint64_t rr_input(int dev, uint64_t val) {
+  switch (mode) {
+    case RR_RECORD:
+      if (val != expected[dev]) {
+        put_uleb(g_nr_guest_inst - last_inst);
+        fputc(dev, fp);
+        put_uleb(val - expected[dev]);
+        last_inst = g_nr_guest_inst;
+      }
+      break;
+    case RR_REPLAY:
+      if (next_dev == RR_END && g_nr_guest_inst >= next_inst) {
+        Log("Replay: the recorded session ends at instruction %" PRIu64, next_inst);
+        nemu_state.state = NEMU_QUIT;
+      }
+      Assert(g_nr_guest_inst <= next_inst || next_dev == RR_END,
+          "Replay diverges: the read of device %d at instruction %" PRIu64 " is missed", next_dev, next_inst);
+      if (g_nr_guest_inst == next_inst && next_dev != RR_END) {
+        Assert(next_dev == dev, "Replay diverges at instruction %" PRIu64
+            ": device %d is read instead of device %d", next_inst, dev, next_dev);
+        val = expected[dev] + next_delta;
+        read_next();
+      } else {
+        val = expected[dev];
+      }
+      break;
+    default: return val;
+  }
+  if (dev == RR_RTC) expected[dev] = val;
+  return val;
+}
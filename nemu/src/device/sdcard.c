@@ -14,6 +14,11 @@
 ***************************************************************************************/
 
 #include <device/map.h>
+#include <memory/paddr.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "mmc.h"
 
 // http://www.files.e-shop.co.il/pdastore/Tech-mmc-samsung/SEC%20MMC%20SPEC%20ver09.pdf
@@ -28,8 +33,15 @@
 #define C_SIZE (NR_BLOCK / MULT - 1)
 
 // This is a simple hardware implementation of linux/drivers/mmc/host/bcm2835.c
-// No DMA and IRQ is supported, so the driver must be modified to start PIO
+// No IRQ is supported, so the driver must be modified to start PIO
 // right after sending the actual read/write commands.
+//
+// The image is mapped into the host memory, so SDDATA is a plain memory
+// copy. Besides, NEMU provides SDDMALEN and SDDMAADDR: writing a guest
+// physical address to SDDMAADDR moves SDDMALEN bytes of the current
+// read/write command between the card and the guest memory at once. A
+// buffer out of pmem sets SDHSTS_FIFO_ERROR in SDHSTS instead, which is
+// cleared by writing 1 to it.
 
 enum {
   SDCMD, SDARG, SDTOUT, SDCDIV,
@@ -37,24 +49,53 @@ enum {
   SDHSTS, __PAD0, __PAD1, __PAD2,
   SDVDD, SDEDM, SDHCFG, SDHBCT,
   SDDATA, __PAD10, __PAD11, __PAD12,
-  SDHBLC
+  SDHBLC, SDDMALEN, SDDMAADDR
 };
 
-static FILE *fp = NULL;
+#define SDHSTS_FIFO_ERROR 0x08
+
+static uint8_t *img = NULL;
+static uint64_t img_size = 0;
 static uint32_t *base = NULL;
 static uint32_t blkcnt = 0;
 static long blk_addr = 0;
 static uint32_t addr = 0;
 static bool write_cmd = 0;
 static bool read_ext_csd = false;
+static uint32_t hsts = 0;
 
 static void prepare_rw(int is_write) {
   blk_addr = base[SDARG];
   addr = 0;
-  if (fp) fseek(fp, blk_addr << 9, SEEK_SET);
   write_cmd = is_write;
 }
 
+// copy `len' bytes at the current position of the transfer, reads beyond
+// the image give zeros and writes beyond it are dropped
+static void transfer(uint8_t *buf, uint64_t len) {
+  uint64_t pos = ((uint64_t)blk_addr << 9) + addr;
+  uint64_t n = (pos >= img_size ? 0 : (len < img_size - pos ? len : img_size - pos));
+  if (!write_cmd) {
+    memcpy(buf, img + pos, n);
+    memset(buf + n, 0, len - n);
+  } else {
+    memcpy(img + pos, buf, n);
+  }
+  addr += len;
+}
+
+static void dma() {
+  paddr_t paddr = base[SDDMAADDR];
+  uint32_t len = base[SDDMALEN];
+  if (!in_pmem(paddr) || len > CONFIG_MSIZE - (paddr - CONFIG_MBASE)) {
+    hsts |= SDHSTS_FIFO_ERROR;
+    base[SDHSTS] = hsts;
+    return;
+  }
+  transfer(guest_to_host(paddr), len);
+  paddr_dma(paddr, len, !write_cmd);
+}
+
 static void sdcard_handle_cmd(int cmd) {
   switch (cmd) {
     case MMC_GO_IDLE_STATE: break;
@@ -109,13 +150,17 @@ static void sdcard_io_handler(uint32_t offset, int len, bool is_write) {
          }
          base[SDDATA] = data;
          if (addr == 512 - 4) read_ext_csd = false;
-       } else if (fp) {
-         __attribute__((unused)) int ret;
-         if (!write_cmd) { ret = fread(&base[SDDATA], 4, 1, fp); }
-         else { ret = fwrite(&base[SDDATA], 4, 1, fp); }
+         addr += 4;
+       } else {
+         transfer((uint8_t *)&base[SDDATA], 4);
        }
-       addr += 4;
        break;
+    case SDHSTS:
+      if (is_write) hsts &= ~base[SDHSTS];
+      base[SDHSTS] = hsts;
+      break;
+    case SDDMALEN: break;
+    case SDDMAADDR: if (is_write) dma(); break;
     default:
       Log("offset = 0x%x(idx = %d), is_write = %d, data = 0x%x", offset, idx, is_write, base[idx]);
       panic("unhandle offset = %d", offset);
@@ -128,7 +173,15 @@ void init_sdcard() {
 
   Assert(C_SIZE < (1 << 12), "shoule be fit in 12 bits");
 
-  const char *img = CONFIG_SDCARD_IMG_PATH;
-  fp = fopen(img, "r+");
-  if (fp == NULL) Log("Can not find sdcard image: %s", img);
+  const char *path = CONFIG_SDCARD_IMG_PATH;
+  int fd = open(path, O_RDWR);
+  if (fd < 0) { Log("Can not find sdcard image: %s", path); return; }
+  struct stat st;
+  Assert(fstat(fd, &st) == 0, "Can not stat '%s'", path);
+  img_size = st.st_size;
+  if (img_size != 0) {
+    img = mmap(NULL, img_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    Assert(img != MAP_FAILED, "Can not mmap '%s'", path);
+  }
+  close(fd);
 }
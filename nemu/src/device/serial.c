@@ -20,21 +20,45 @@
 // NOTE: this is compatible to 16550
 
 #define CH_OFFSET 0
+// NEMU only: a write of up to 4 bytes sends them in order, stopping at '\0'
+#define TX_OFFSET 4
 
 static uint8_t *serial_base = NULL;
 
+/* The output is buffered and flushed on a newline, when the buffer is
+ * full, periodically by device_update(), when the CPU stops and at exit,
+ * so that a chatty guest does not cost a host write per character. */
+static char tx_buf[CONFIG_SERIAL_TX_BUF_SIZE];
+static int tx_len = 0;
+
+void serial_flush() {
+  if (tx_len == 0) return;
+#ifdef CONFIG_TARGET_AM
+  for (int i = 0; i < tx_len; i ++) putch(tx_buf[i]);
+#else
+  fwrite(tx_buf, 1, tx_len, stderr);
+#endif
+  tx_len = 0;
+}
 
 static void serial_putc(char ch) {
-  MUXDEF(CONFIG_TARGET_AM, putch(ch), putc(ch, stderr));
+  tx_buf[tx_len ++] = ch;
+  if (ch == '\n' || tx_len == sizeof(tx_buf)) serial_flush();
 }
 
 static void serial_io_handler(uint32_t offset, int len, bool is_write) {
-  assert(len == 1);
+  if (!is_write) panic("do not support read");
   switch (offset) {
     /* We bind the serial port with the host stderr in NEMU. */
     case CH_OFFSET:
-      if (is_write) serial_putc(serial_base[0]);
-      else panic("do not support read");
+      assert(len == 1);
+      serial_putc(serial_base[CH_OFFSET]);
+      break;
+    case TX_OFFSET:
+      assert(len <= 4);
+      for (int i = 0; i < len && serial_base[TX_OFFSET + i] != '\0'; i ++) {
+        serial_putc(serial_base[TX_OFFSET + i]);
+      }
       break;
     default: panic("do not support offset = %d", offset);
   }
@@ -47,5 +71,5 @@ void init_serial() {
 #else
   add_mmio_map("serial", CONFIG_SERIAL_MMIO, serial_base, 8, serial_io_handler);
 #endif
-
+  IFNDEF(CONFIG_TARGET_AM, atexit(serial_flush));
 }
@@ -13,16 +13,56 @@
 * See the Mulan PSL v2 for more details.
 ***************************************************************************************/
 
-#include <device/map.h>
+#include <machine.h>
 #include <device/alarm.h>
+#include <device/replay.h>
 #include <utils.h>
 
 static uint32_t *rtc_port_base = NULL;
 
+#ifdef CONFIG_TIMER_IDLE_SLEEP
+#include <unistd.h>
+
+/* A guest waiting for the next frame polls the RTC in a tight loop. When
+ * the RTC is read again by the same instruction within IDLE_WINDOW
+ * instructions for IDLE_POLLS times in a row, and no other device is
+ * accessed in between, the host thread sleeps for IDLE_SLEEP_US before
+ * each read, so an idle guest costs little host CPU. A loop which also
+ * drives a device, e.g. draws a frame, is not waiting and never sleeps.
+ */
+#define IDLE_WINDOW 256
+#define IDLE_POLLS 16
+#define IDLE_SLEEP_US 100
+
+// the accesses to the RTC, to tell whether other devices are accessed
+static uint64_t nr_rtc_io = 0;
+
+static void idle_sleep() {
+  static vaddr_t last_pc = 0;
+  static uint64_t last_inst = 0, last_io = 0, last_rtc_io = 0;
+  static int nr_poll = 0;
+  bool only_rtc = (g_machine->nr_io - last_io == nr_rtc_io - last_rtc_io);
+  if (cpu.pc == last_pc && g_nr_guest_inst - last_inst < IDLE_WINDOW && only_rtc) {
+    if (nr_poll < IDLE_POLLS) nr_poll ++;
+    // a replay does not wait for the host clock
+    else if (!MUXDEF(CONFIG_RECORD_REPLAY, rr_replaying(), false)) usleep(IDLE_SLEEP_US);
+  } else {
+    nr_poll = 0;
+  }
+  last_pc = cpu.pc;
+  last_inst = g_nr_guest_inst;
+  last_io = g_machine->nr_io;
+  last_rtc_io = nr_rtc_io;
+}
+#endif
+
 static void rtc_io_handler(uint32_t offset, int len, bool is_write) {
   assert(offset == 0 || offset == 4);
+  IFDEF(CONFIG_TIMER_IDLE_SLEEP, nr_rtc_io ++);
   if (!is_write && offset == 4) {
+    IFDEF(CONFIG_TIMER_IDLE_SLEEP, idle_sleep());
     uint64_t us = get_time();
+    IFDEF(CONFIG_RECORD_REPLAY, us = rr_input(RR_RTC, us));
     rtc_port_base[0] = (uint32_t)us;
     rtc_port_base[1] = us >> 32;
   }
@@ -15,6 +15,7 @@
 
 #include <common.h>
 #include <device/map.h>
+#include <memory/paddr.h>
 
 #define SCREEN_W (MUXDEF(CONFIG_VGA_SIZE_800x600, 800, 400))
 #define SCREEN_H (MUXDEF(CONFIG_VGA_SIZE_800x600, 600, 300))
@@ -34,6 +35,105 @@ static uint32_t screen_size() {
 static void *vmem = NULL;
 static uint32_t *vgactl_port_base = NULL;
 
+/* A 2D engine. The driver puts commands into a ring in guest memory and
+ * writes the number of commands it has made so far to reg_avail, then all
+ * of them are executed on the frame buffer by the host, with memcpy() for
+ * the rows which need no conversion. The source of a blit may be in pmem
+ * or in the frame buffer, so copying a rectangle on the screen is a blit.
+ */
+enum {
+  reg_wh, reg_sync,
+  reg_queue_addr,  // guest physical address of the command ring
+  reg_queue_size,  // number of commands, a power of 2
+  reg_avail,       // written by the driver
+  reg_used,        // written by the device
+  nr_reg
+};
+
+enum { GPU_FILL = 1, GPU_BLIT, GPU_BLIT8 };
+
+typedef struct {
+  uint32_t op;
+  uint32_t color;       // GPU_FILL: the color, GPU_BLIT8: address of the 256-entry palette
+  uint32_t src;         // address of the source pixels, 32 bits (GPU_BLIT) or 8 bits (GPU_BLIT8) each
+  uint32_t pitch;       // of the source, in pixels
+  uint32_t sw, sh;      // size of the source, scaled to w * h
+  int32_t x, y, w, h;   // the destination rectangle
+} GpuCmd;
+
+static void* gpu_ptr(uint32_t addr, uint64_t len) {
+  if (in_pmem(addr) && len <= CONFIG_MSIZE - (addr - CONFIG_MBASE)) return guest_to_host(addr);
+  if (addr - CONFIG_FB_ADDR < screen_size() && len <= screen_size() - (addr - CONFIG_FB_ADDR)) {
+    return (uint8_t *)vmem + (addr - CONFIG_FB_ADDR);
+  }
+  panic("vga: [0x%08x, +0x%" PRIx64 ") is neither in pmem nor in the frame buffer", addr, len);
+}
+
+static void gpu_fill(GpuCmd *c, int x0, int y0, int x1, int y1) {
+  uint32_t *fb = vmem;
+  int w = screen_width();
+  for (int x = x0; x < x1; x ++) fb[y0 * w + x] = c->color;
+  for (int y = y0 + 1; y < y1; y ++) memcpy(&fb[y * w + x0], &fb[y0 * w + x0], (x1 - x0) * 4);
+}
+
+static void gpu_blit(GpuCmd *c, int x0, int y0, int x1, int y1) {
+  if (c->sw == 0 || c->sh == 0) return;
+  int bpp = (c->op == GPU_BLIT8 ? 1 : 4);
+  uint8_t *src = gpu_ptr(c->src, ((uint64_t)c->pitch * (c->sh - 1) + c->sw) * bpp);
+  uint32_t *pal = (bpp == 1 ? gpu_ptr(c->color, 256 * sizeof(uint32_t)) : NULL);
+  bool scaled = (c->sw != c->w || c->sh != c->h);
+  uint32_t *fb = vmem;
+  int w = screen_width();
+  if (!scaled && bpp == 4 && x0 == 0 && x1 == w && c->x == 0 && c->pitch == w) {
+    // full-width rows are contiguous in both
+    memmove(fb + y0 * w, src + (uint64_t)(y0 - c->y) * w * 4, (uint64_t)(y1 - y0) * w * 4);
+    return;
+  }
+  // go upward when moving a rectangle down on the screen
+  bool up = ((uint8_t *)&fb[y0 * w] > src);
+  for (int i = 0; i < y1 - y0; i ++) {
+    int y = (up ? y1 - 1 - i : y0 + i);
+    uint64_t sy = (scaled ? (uint64_t)(y - c->y) * c->sh / c->h : y - c->y);
+    uint8_t *row = src + sy * c->pitch * bpp;
+    uint32_t *dst = &fb[y * w];
+    if (!scaled && bpp == 4) {
+      memmove(&dst[x0], (uint32_t *)row + (x0 - c->x), (x1 - x0) * 4);
+      continue;
+    }
+    for (int x = x0; x < x1; x ++) {
+      uint64_t sx = (scaled ? (uint64_t)(x - c->x) * c->sw / c->w : x - c->x);
+      dst[x] = (bpp == 1 ? pal[row[sx]] : ((uint32_t *)row)[sx]);
+    }
+  }
+}
+
+static void gpu_exec(GpuCmd *c) {
+  // clip the destination to the screen
+  int64_t x0 = (c->x > 0 ? c->x : 0), x1 = (int64_t)c->x + c->w;
+  int64_t y0 = (c->y > 0 ? c->y : 0), y1 = (int64_t)c->y + c->h;
+  if (x1 > screen_width()) x1 = screen_width();
+  if (y1 > screen_height()) y1 = screen_height();
+  if (x0 >= x1 || y0 >= y1) return;
+  switch (c->op) {
+    case GPU_FILL: gpu_fill(c, x0, y0, x1, y1); break;
+    case GPU_BLIT: case GPU_BLIT8: gpu_blit(c, x0, y0, x1, y1); break;
+    default: panic("vga: bad command %d", c->op);
+  }
+}
+
+static void vga_io_handler(uint32_t offset, int len, bool is_write) {
+  if (!is_write || offset / sizeof(uint32_t) != reg_avail) return;
+  uint32_t size = vgactl_port_base[reg_queue_size];
+  Assert(size != 0 && (size & (size - 1)) == 0, "vga: bad queue size %d", size);
+  uint32_t used = vgactl_port_base[reg_used];
+  for (; used != vgactl_port_base[reg_avail]; used ++) {
+    uint32_t addr = vgactl_port_base[reg_queue_addr] + (used & (size - 1)) * sizeof(GpuCmd);
+    GpuCmd *c = gpu_ptr(addr, sizeof(GpuCmd));
+    gpu_exec(c);
+  }
+  vgactl_port_base[reg_used] = used;
+}
+
 #ifdef CONFIG_VGA_SHOW_SCREEN
 #ifndef CONFIG_TARGET_AM
 #include <SDL2/SDL.h>
@@ -74,20 +174,22 @@ static inline void update_screen() {
 void vga_update_screen() {
   // TODO: call `update_screen()` when the sync register is non-zero,
   // then zero out the sync register
-  uint32_t sync = vgactl_port_base[1];
+  uint32_t sync = vgactl_port_base[reg_sync];
   if (sync) {
     update_screen();
-    vgactl_port_base[1] = 0;
+    vgactl_port_base[reg_sync] = 0;
   }
 }
 
 void init_vga() {
-  vgactl_port_base = (uint32_t *)new_space(8);
-  vgactl_port_base[0] = (screen_width() << 16) | screen_height();
+  uint32_t space_size = sizeof(uint32_t) * nr_reg;
+  vgactl_port_base = (uint32_t *)new_space(space_size);
+  memset(vgactl_port_base, 0, space_size);
+  vgactl_port_base[reg_wh] = (screen_width() << 16) | screen_height();
 #ifdef CONFIG_HAS_PORT_IO
-  add_pio_map ("vgactl", CONFIG_VGA_CTL_PORT, vgactl_port_base, 8, NULL);
+  add_pio_map ("vgactl", CONFIG_VGA_CTL_PORT, vgactl_port_base, space_size, vga_io_handler);
 #else
-  add_mmio_map("vgactl", CONFIG_VGA_CTL_MMIO, vgactl_port_base, 8, NULL);
+  add_mmio_map("vgactl", CONFIG_VGA_CTL_MMIO, vgactl_port_base, space_size, vga_io_handler);
 #endif
 
   vmem = new_space(screen_size());
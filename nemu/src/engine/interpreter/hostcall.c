@@ -16,7 +16,11 @@
 #include <utils.h>
 #include <cpu/ifetch.h>
 #include <isa.h>
+#include <cpu/cpu.h>
 #include <cpu/difftest.h>
+#include <cpu/breakpoint.h>
+#include <memory/paddr.h>
+#include <plugin.h>
 
 void set_nemu_state(int state, vaddr_t pc, int halt_ret) {
   difftest_skip_ref();
@@ -49,3 +53,62 @@ void invalid_inst(vaddr_t thispc) {
 
   set_nemu_state(NEMU_ABORT, thispc, -1);
 }
+
+// the host address of [addr, addr + len) when it is all in pmem, or NULL
+static uint8_t* host_range(word_t addr, word_t len, int type) {
+  if (isa_mmu_check(addr, len, type) != MMU_DIRECT) return NULL;
+  if (!in_pmem(addr) || len > CONFIG_MSIZE - (addr - CONFIG_MBASE)) return NULL;
+  return guest_to_host(addr);
+}
+
+/* The operations work like their counterparts in the C library, with the
+ * arguments and the result in the registers of the ISA. Return false when
+ * the guest should do it by itself, i.e. when an operand is not in pmem,
+ * or when watchpoints or memory callbacks of plugins need to see every
+ * access. The accesses are not seen by the cache simulator and the
+ * statistics either.
+ */
+bool hostcall_mem(int op, word_t *ret, word_t a0, word_t a1, word_t a2) {
+  if (MUXDEF(CONFIG_BREAKPOINT, nr_mw != 0, false)) return false;
+  if (MUXDEF(CONFIG_PLUGIN, PLUGIN_ON(PLUGIN_MEM), false)) return false;
+
+  uint8_t *p0, *p1;
+  switch (op) {
+    case HOSTCALL_MEMCPY: case HOSTCALL_MEMMOVE:
+      if (a2 != 0) {
+        if ((p0 = host_range(a0, a2, MEM_TYPE_WRITE)) == NULL) return false;
+        if ((p1 = host_range(a1, a2, MEM_TYPE_READ)) == NULL) return false;
+        memmove(p0, p1, a2);
+        difftest_sync_mem(a0, a2);
+      }
+      *ret = a0;
+      break;
+    case HOSTCALL_MEMSET:
+      if (a2 != 0) {
+        if ((p0 = host_range(a0, a2, MEM_TYPE_WRITE)) == NULL) return false;
+        memset(p0, a1, a2);
+        difftest_sync_mem(a0, a2);
+      }
+      *ret = a0;
+      break;
+    case HOSTCALL_MEMCMP: {
+      int r = 0;
+      if (a2 != 0) {
+        if ((p0 = host_range(a0, a2, MEM_TYPE_READ)) == NULL) return false;
+        if ((p1 = host_range(a1, a2, MEM_TYPE_READ)) == NULL) return false;
+        r = memcmp(p0, p1, a2);
+      }
+      *ret = (sword_t)(r < 0 ? -1 : r > 0);
+      break;
+    }
+    case HOSTCALL_STRLEN: {
+      if ((p0 = host_range(a0, 1, MEM_TYPE_READ)) == NULL) return false;
+      uint8_t *end = memchr(p0, '\0', CONFIG_MSIZE - (a0 - CONFIG_MBASE));
+      if (end == NULL) return false;
+      *ret = end - p0;
+      break;
+    }
+    default: return false;
+  }
+  return true;
+}
@@ -22,6 +22,10 @@ typedef struct {
   word_t gpr[MUXDEF(CONFIG_RVE, 16, 32)];
   vaddr_t pc;
   word_t mcause, mstatus, mepc, mtvec;
+  word_t medeleg, mideleg, mie, mip, mcounteren, mscratch, mtval;
+  word_t stvec, scounteren, sscratch, sepc, scause, stval, satp;
+  uint64_t cycle_offset, instret_offset; // mcycle/minstret - instructions executed
+  int priv; // the current privilege level
 } MUXDEF(CONFIG_RV64, riscv64_CPU_state, riscv32_CPU_state);
 
 // decode
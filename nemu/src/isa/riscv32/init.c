@@ -15,6 +15,7 @@
 
 #include <isa.h>
 #include <memory/paddr.h>
+#include "local-include/csr.h"
 
 // this is not consistent with uint8_t
 // but it is ok since we do not access the array directly
@@ -32,6 +33,7 @@ static void restart() {
 
   /* Set the initial valude of mstatus register */
   cpu.mstatus = 0xa00001800;
+  cpu.priv = PRV_M;
 
   /* The zero register is always 0. */
   cpu.gpr[0] = 0;
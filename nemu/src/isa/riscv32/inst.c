@@ -14,9 +14,15 @@
 ***************************************************************************************/
 
 #include "local-include/reg.h"
+#include "local-include/csr.h"
 #include <cpu/cpu.h>
 #include <cpu/ifetch.h>
 #include <cpu/decode.h>
+#include <cpu/stats.h>
+#include <cpu/bpred.h>
+#include <cpu/coverage.h>
+#include <cpu/event.h>
+#include <cpu/difftest.h>
 
 #define R(i) gpr(i)
 #define Mr vaddr_read
@@ -50,17 +56,42 @@ static void decode_operand(Decode *s, int *rd, word_t *src1, word_t *src2, word_
   }
 }
 
-static word_t *get_csr_register(word_t no) {
-  switch (no) {
-    case 0x300: return &cpu.mstatus;
-    case 0x305: return &cpu.mtvec;
-    case 0x341: return &cpu.mepc;
-    case 0x342: return &cpu.mcause;
-    default:
-      panic("Error csr register No!\n");
-  }
+static void raise_illegal_inst(Decode *s) {
+  s->dnpc = isa_raise_intr(EXC_II, s->pc);
+  *(cpu.priv == PRV_M ? &cpu.mtval : &cpu.stval) = s->isa.inst.val;
+}
+
+// wait for an interrupt by skipping the virtual time to the next event
+static void wfi(Decode *s) {
+  if (cpu.priv < PRV_M && (cpu.mstatus & MSTATUS_TW)) raise_illegal_inst(s);
+  else if ((cpu.mip & cpu.mie) == 0) event_idle();
+}
+
+/* hostcall, in the custom-0 opcode space: funct3 selects the operation,
+ * the arguments are in a0-a2, the result is written to a0, and a3 is set
+ * to 0 when the host has done the operation, or 1 when the guest should */
+static void hostcall(Decode *s) {
+  word_t ret;
+  bool ok = hostcall_mem(BITS(s->isa.inst.val, 14, 12), &ret, R(10), R(11), R(12));
+  if (ok) R(10) = ret;
+  R(13) = !ok;
+  // the reference of DiffTest does not know this instruction, so copy a0
+  // and a3 to it whatever the outcome; the memory written is pushed to
+  // it by hostcall_mem()
+  difftest_skip_ref();
 }
 
+// the rs1 field, which is a register or an unsigned immediate of CSR instructions
+#define ZIMM() BITS(s->isa.inst.val, 19, 15)
+// x1 (ra) and x5 (t0) are the link registers of calls and returns
+#define IS_LINK(r) ((r) == 1 || (r) == 5)
+
+#define CSR(op, val, write) do { \
+  word_t old; \
+  if (csr_access(BITS(imm, 11, 0), op, val, write, &old)) R(rd) = old; \
+  else raise_illegal_inst(s); \
+} while (0)
+
 static int decode_exec(Decode *s) {
   int rd = 0;
   word_t src1 = 0, src2 = 0, imm = 0;
@@ -70,6 +101,11 @@ static int decode_exec(Decode *s) {
 #define INSTPAT_MATCH(s, name, type, ... /* execute body */ ) { \
   decode_operand(s, &rd, &src1, &src2, &imm, concat(TYPE_, type)); \
   __VA_ARGS__ ; \
+  IFDEF(CONFIG_STATS, STATS_INST(name)); \
+  IFDEF(CONFIG_STATS, if (concat(TYPE_, type) == TYPE_B) STATS_BRANCH(s->dnpc != s->snpc)); \
+  IFDEF(CONFIG_BPRED, if (concat(TYPE_, type) == TYPE_B) bpred_update(s->pc, BR_COND, s->dnpc != s->snpc, s->dnpc)); \
+  /* the fall-through of a branch not taken also begins a block */ \
+  IFDEF(CONFIG_COVERAGE, if (concat(TYPE_, type) == TYPE_B && s->dnpc == s->snpc) cov_mark(s->snpc)); \
 }
 
   INSTPAT_START();
@@ -79,9 +115,16 @@ static int decode_exec(Decode *s) {
   INSTPAT("??????? ????? ????? 000 ????? 01000 11", sb     , S, Mw(src1 + imm, 1, src2));
 
   INSTPAT("0000000 00001 00000 000 00000 11100 11", ebreak , N, NEMUTRAP(s->pc, R(10))); // R(10) is $a0
-  INSTPAT("0011000 00010 00000 000 00000 11100 11", mret   , R, cpu.mstatus = 0xa00000080; s->dnpc = cpu.mepc); //atfer mret, mstatus.MPP will be set to '00', and mstatus.MPIE will be set to '1', mstatus == 0xa00000080
-  INSTPAT("??????? ????? ????? 001 ????? 11100 11", csrrw  , I, word_t *csr_ptr = get_csr_register(imm); R(rd) = *csr_ptr;  *csr_ptr = src1);
-  INSTPAT("??????? ????? ????? 010 ????? 11100 11", csrrs  , I, word_t *csr_ptr = get_csr_register(imm); R(rd) = *csr_ptr;  (*csr_ptr) |= src1);
+  INSTPAT("0011000 00010 00000 000 00000 11100 11", mret   , R, if (cpu.priv == PRV_M) s->dnpc = isa_mret(); else raise_illegal_inst(s));
+  INSTPAT("0001000 00010 00000 000 00000 11100 11", sret   , R, if (cpu.priv >= PRV_S) s->dnpc = isa_sret(); else raise_illegal_inst(s));
+  INSTPAT("0001000 00101 00000 000 00000 11100 11", wfi    , N, wfi(s));
+  INSTPAT("0000000 00000 00000 ??? 00000 00010 11", hostcall, N, hostcall(s));
+  INSTPAT("??????? ????? ????? 001 ????? 11100 11", csrrw  , I, CSR(CSR_RW, src1, true));
+  INSTPAT("??????? ????? ????? 010 ????? 11100 11", csrrs  , I, CSR(CSR_RS, src1, ZIMM() != 0));
+  INSTPAT("??????? ????? ????? 011 ????? 11100 11", csrrc  , I, CSR(CSR_RC, src1, ZIMM() != 0));
+  INSTPAT("??????? ????? ????? 101 ????? 11100 11", csrrwi , I, CSR(CSR_RW, ZIMM(), true));
+  INSTPAT("??????? ????? ????? 110 ????? 11100 11", csrrsi , I, CSR(CSR_RS, ZIMM(), ZIMM() != 0));
+  INSTPAT("??????? ????? ????? 111 ????? 11100 11", csrrci , I, CSR(CSR_RC, ZIMM(), ZIMM() != 0));
   INSTPAT("0000000 ????? ????? 000 ????? 01100 11", add    , R, R(rd) = src1 + src2);
   INSTPAT("??????? ????? ????? 000 ????? 00100 11", addi   , I, R(rd) = src1 + imm);
   INSTPAT("0000000 ????? ????? 000 ????? 01110 11", addw   , R, R(rd) = SEXT(src1 + src2, 32));
@@ -98,18 +141,24 @@ static int decode_exec(Decode *s) {
   INSTPAT("0000001 ????? ????? 111 ????? 01100 11", remu   , R, R(rd) = (uint64_t)src1 % (uint64_t)src2);
   INSTPAT("0000001 ????? ????? 110 ????? 01110 11", remw   , R, R(rd) = SEXT((int32_t)BITS(src1, 31, 0) % (int32_t)BITS(src2, 31, 0), 32));
   INSTPAT("0000001 ????? ????? 111 ????? 01110 11", remuw  , R, R(rd) = SEXT((uint32_t)BITS(src1, 31, 0) % (uint32_t)BITS(src2, 31, 0), 32));
-  INSTPAT("??????? ????? ????? ??? ????? 11011 11", jal    , J, R(rd) = s->pc + 4; s->dnpc = s->pc + imm; func_trace_call(s->pc, s->dnpc, false));
+  INSTPAT("??????? ????? ????? ??? ????? 11011 11", jal    , J, R(rd) = s->pc + 4; s->dnpc = s->pc + imm; func_trace_call(s->pc, s->dnpc, false);
+    IFDEF(CONFIG_PROFILE, profile_call(s->pc, s->dnpc, rd == 0));
+    IFDEF(CONFIG_BPRED, bpred_update(s->pc, (IS_LINK(rd) ? BR_CALL : BR_JUMP), true, s->dnpc)));
   INSTPAT("??????? ????? ????? 000 ????? 11001 11", jalr   , I, R(rd) = s->pc + 4; s->dnpc = (src1 + imm) & (~1); 
   if (s->isa.inst.val == 0x00008067) {
     // ret
     func_trace_ret(s->pc);
+    IFDEF(CONFIG_PROFILE, profile_ret());
   } else if (rd == 1) {
     // jalr rd, offset(rs1)
     func_trace_call(s->pc, s->dnpc, false);
+    IFDEF(CONFIG_PROFILE, profile_call(s->pc, s->dnpc, false));
   } else if (rd == 0 && imm == 0) {
     // jr
     func_trace_call(s->pc, s->dnpc, true);
-  });
+    IFDEF(CONFIG_PROFILE, profile_call(s->pc, s->dnpc, true));
+  }
+  IFDEF(CONFIG_BPRED, bpred_update(s->pc, (IS_LINK(rd) ? BR_CALL : IS_LINK(BITS(s->isa.inst.val, 19, 15)) ? BR_RET : BR_IND), true, s->dnpc)));
   INSTPAT("??????? ????? ????? 011 ????? 01000 11", sd     , S, Mw(src1 + imm, 8, src2));
   INSTPAT("??????? ????? ????? 010 ????? 01000 11", sw     , S, Mw(src1 + imm, 4, src2));
   INSTPAT("??????? ????? ????? 011 ????? 00000 11", ld     , I, R(rd) = Mr(src1 + imm, 8));
@@ -146,7 +195,7 @@ static int decode_exec(Decode *s) {
   INSTPAT("0000000 ????? ????? 100 ????? 01100 11", xor    , R, R(rd) = src1 ^ src2);
   INSTPAT("0000000 ????? ????? 110 ????? 01100 11", or     , R, R(rd) = src1 | src2);
   INSTPAT("??????? ????? ????? ??? ????? 01101 11", lui    , U, R(rd) = imm);
-  INSTPAT("0000000 00000 00000 000 00000 11100 11", ecall  , I, bool success = true; s->dnpc = isa_raise_intr(isa_reg_str2val("$a7", &success), s->pc); cpu.mstatus = 0xa00001800;);  // after ecall, mstatus.MPP will be set to '11', and mstatus.MPIE will be set to mstatus.MPIE, mstatus == 0xa00001800
+  INSTPAT("0000000 00000 00000 000 00000 11100 11", ecall  , I, s->dnpc = isa_raise_intr(EXC_ECALL_U + cpu.priv, s->pc));
   INSTPAT("??????? ????? ????? ??? ????? ????? ??", inv    , N, INV(s->pc));
   INSTPAT_END();
 
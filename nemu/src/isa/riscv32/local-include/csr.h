@@ -0,0 +1,46 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __RISCV_CSR_H__
+#define __RISCV_CSR_H__
+
+#include <common.h>
+
+enum { PRV_U = 0, PRV_S = 1, PRV_M = 3 };
+
+// exception codes
+enum { EXC_II = 2, EXC_ECALL_U = 8 };
+
+enum { CSR_RW, CSR_RS, CSR_RC };
+
+#define MSTATUS_SIE  (1ul << 1)
+#define MSTATUS_MIE  (1ul << 3)
+#define MSTATUS_SPIE (1ul << 5)
+#define MSTATUS_MPIE (1ul << 7)
+#define MSTATUS_SPP  (1ul << 8)
+#define MSTATUS_MPP  (3ul << 11)
+#define MSTATUS_MPP_SHIFT 11
+#define MSTATUS_TW   (1ul << 21)
+
+#define MIP_MSIP (1ul << 3)
+#define MIP_MTIP (1ul << 7)
+
+// return false if the access is illegal
+bool csr_access(int no, int op, word_t val, bool write, word_t *old);
+
+vaddr_t isa_mret();
+vaddr_t isa_sret();
+
+#endif
@@ -0,0 +1,188 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <cpu/event.h>
+#include <stddef.h>
+#include "../local-include/csr.h"
+
+/* The CSR file. A CSR is either a field of CPU_state, of which only the
+ * bits in `wmask' are writable, or a view computed by `read' and `write'.
+ * The privilege needed and whether a CSR is read-only are given by its
+ * number; the counters below 0xc20 are further gated by mcounteren and
+ * scounteren. Unknown CSRs are a bug of NEMU or the guest, so we panic.
+ */
+
+typedef struct {
+  const char *name;
+  int offset;   // of the field in CPU_state, 0 if `read' and `write' are used
+  word_t wmask; // writable bits of the field
+  word_t (*read)();
+  void (*write)(word_t val);
+} CSR;
+
+#define XLEN MUXDEF(CONFIG_RV64, 64, 32)
+
+#define MSTATUS_WMASK  0x7e19aa // SIE MIE SPIE MPIE SPP MPP MPRV SUM MXR TVM TW TSR
+#define SSTATUS_WMASK  0x0c0122 // SIE SPIE SPP SUM MXR
+#define SSTATUS_RMASK  (SSTATUS_WMASK | MUXDEF(CONFIG_RV64, 3ul << 32, 0) | (1ul << (XLEN - 1))) // + UXL SD
+#define MIP_MASK       0xaaa    // SSIP MSIP STIP MTIP SEIP MEIP
+#define MIP_WMASK      0x222    // SSIP STIP SEIP
+#define MEDELEG_WMASK  0xb3ff   // all exceptions but ecall from M-mode
+
+// the counters run at one cycle per instruction, the time is the virtual time
+static uint64_t cycle()   { return g_nr_guest_inst + cpu.cycle_offset; }
+static uint64_t instret() { return g_nr_guest_inst + cpu.instret_offset; }
+
+// the CSR instruction writing a counter does not increase it
+#define SET_COUNTER(offset, val) (offset = (val) - g_nr_guest_inst - 1)
+
+static word_t read_cycle()     { return cycle(); }
+static word_t read_instret()   { return instret(); }
+static word_t read_time()      { return vtime(); }
+static void write_mcycle(word_t val) {
+  SET_COUNTER(cpu.cycle_offset, MUXDEF(CONFIG_RV64, val, (cycle() & ~0xffffffffull) | val));
+}
+static void write_minstret(word_t val) {
+  SET_COUNTER(cpu.instret_offset, MUXDEF(CONFIG_RV64, val, (instret() & ~0xffffffffull) | val));
+}
+#ifndef CONFIG_RV64
+static word_t read_cycleh()    { return cycle() >> 32; }
+static word_t read_instreth()  { return instret() >> 32; }
+static word_t read_timeh()     { return vtime() >> 32; }
+static void write_mcycleh(word_t val)   { SET_COUNTER(cpu.cycle_offset, ((uint64_t)val << 32) | (uint32_t)cycle()); }
+static void write_minstreth(word_t val) { SET_COUNTER(cpu.instret_offset, ((uint64_t)val << 32) | (uint32_t)instret()); }
+#endif
+
+static word_t read_zero()      { return 0; }
+static void write_none(word_t val) { }
+
+static word_t read_misa() {
+  // RV32/64 IMSU
+  return ((word_t)MUXDEF(CONFIG_RV64, 2, 1) << (XLEN - 2)) |
+    (1 << ('I' - 'A')) | (1 << ('M' - 'A')) | (1 << ('S' - 'A')) | (1 << ('U' - 'A'));
+}
+
+static word_t read_mstatus() { return cpu.mstatus; }
+static void write_mstatus(word_t val) {
+  // MPP is WARL, and 2 is reserved
+  if ((val & MSTATUS_MPP) == (2ul << MSTATUS_MPP_SHIFT)) val = (val & ~MSTATUS_MPP) | (cpu.mstatus & MSTATUS_MPP);
+  cpu.mstatus = (cpu.mstatus & ~MSTATUS_WMASK) | (val & MSTATUS_WMASK);
+}
+
+static word_t read_sstatus() { return cpu.mstatus & SSTATUS_RMASK; }
+static void write_sstatus(word_t val) {
+  cpu.mstatus = (cpu.mstatus & ~SSTATUS_WMASK) | (val & SSTATUS_WMASK);
+}
+
+static word_t read_sie() { return cpu.mie & cpu.mideleg; }
+static void write_sie(word_t val) { cpu.mie = (cpu.mie & ~cpu.mideleg) | (val & cpu.mideleg); }
+
+static word_t read_sip() { return cpu.mip & cpu.mideleg; }
+static void write_sip(word_t val) {
+  word_t mask = cpu.mideleg & 0x2; // only SSIP is writable
+  cpu.mip = (cpu.mip & ~mask) | (val & mask);
+}
+
+static word_t read_satp() { return cpu.satp; }
+static void write_satp(word_t val) {
+  // there is no MMU, so a write to enable translation has no effect
+  if (MUXDEF(CONFIG_RV64, val >> 60, val >> 31) == 0) cpu.satp = val;
+}
+
+#define REG(r, mask) .offset = offsetof(CPU_state, r), .wmask = (mask)
+#define FUNC(r, w)   .read = r, .write = w
+#define ALL ((word_t)-1)
+
+static const CSR csr_table[4096] = {
+  // supervisor
+  [0x100] = { "sstatus",    FUNC(read_sstatus, write_sstatus) },
+  [0x104] = { "sie",        FUNC(read_sie, write_sie) },
+  [0x105] = { "stvec",      REG(stvec, ~(word_t)2) },
+  [0x106] = { "scounteren", REG(scounteren, 0xffffffff) },
+  [0x140] = { "sscratch",   REG(sscratch, ALL) },
+  [0x141] = { "sepc",       REG(sepc, ~(word_t)3) },
+  [0x142] = { "scause",     REG(scause, ALL) },
+  [0x143] = { "stval",      REG(stval, ALL) },
+  [0x144] = { "sip",        FUNC(read_sip, write_sip) },
+  [0x180] = { "satp",       FUNC(read_satp, write_satp) },
+
+  // machine
+  [0xf11] = { "mvendorid",  FUNC(read_zero, NULL) },
+  [0xf12] = { "marchid",    FUNC(read_zero, NULL) },
+  [0xf13] = { "mimpid",     FUNC(read_zero, NULL) },
+  [0xf14] = { "mhartid",    FUNC(read_zero, NULL) },
+  [0x300] = { "mstatus",    FUNC(read_mstatus, write_mstatus) },
+  [0x301] = { "misa",       FUNC(read_misa, write_none) },
+  [0x302] = { "medeleg",    REG(medeleg, MEDELEG_WMASK) },
+  [0x303] = { "mideleg",    REG(mideleg, MIP_WMASK) },
+  [0x304] = { "mie",        REG(mie, MIP_MASK) },
+  [0x305] = { "mtvec",      REG(mtvec, ~(word_t)2) },
+  [0x306] = { "mcounteren", REG(mcounteren, 0xffffffff) },
+  [0x323 ... 0x33f] = { "mhpmevent", FUNC(read_zero, write_none) },
+  [0x340] = { "mscratch",   REG(mscratch, ALL) },
+  [0x341] = { "mepc",       REG(mepc, ~(word_t)3) },
+  [0x342] = { "mcause",     REG(mcause, ALL) },
+  [0x343] = { "mtval",      REG(mtval, ALL) },
+  [0x344] = { "mip",        REG(mip, MIP_WMASK) },
+  [0xb00] = { "mcycle",     FUNC(read_cycle, write_mcycle) },
+  [0xb02] = { "minstret",   FUNC(read_instret, write_minstret) },
+  [0xb03 ... 0xb1f] = { "mhpmcounter", FUNC(read_zero, write_none) },
+#ifndef CONFIG_RV64
+  [0xb80] = { "mcycleh",    FUNC(read_cycleh, write_mcycleh) },
+  [0xb82] = { "minstreth",  FUNC(read_instreth, write_minstreth) },
+  [0xb83 ... 0xb9f] = { "mhpmcounterh", FUNC(read_zero, write_none) },
+#endif
+
+  // user, read-only
+  [0xc00] = { "cycle",      FUNC(read_cycle, NULL) },
+  [0xc01] = { "time",       FUNC(read_time, NULL) },
+  [0xc02] = { "instret",    FUNC(read_instret, NULL) },
+  [0xc03 ... 0xc1f] = { "hpmcounter", FUNC(read_zero, NULL) },
+#ifndef CONFIG_RV64
+  [0xc80] = { "cycleh",     FUNC(read_cycleh, NULL) },
+  [0xc81] = { "timeh",      FUNC(read_timeh, NULL) },
+  [0xc82] = { "instreth",   FUNC(read_instreth, NULL) },
+  [0xc83 ... 0xc9f] = { "hpmcounterh", FUNC(read_zero, NULL) },
+#endif
+};
+
+static bool counter_enabled(int no) {
+  word_t bit = (word_t)1 << (no & 0x1f);
+  if (cpu.priv < PRV_M && !(cpu.mcounteren & bit)) return false;
+  if (cpu.priv < PRV_S && !(cpu.scounteren & bit)) return false;
+  return true;
+}
+
+bool csr_access(int no, int op, word_t val, bool write, word_t *old) {
+  const CSR *c = &csr_table[no];
+  if (c->name == NULL) panic("Error csr register No! 0x%03x", no);
+
+  if (cpu.priv < BITS(no, 9, 8)) return false;
+  if (write && BITS(no, 11, 10) == 3) return false;
+  if ((no & ~0x9f) == 0xc00 && !counter_enabled(no)) return false;
+
+  word_t *reg = (word_t *)((uint8_t *)&cpu + c->offset);
+  word_t cur = (c->read != NULL ? c->read() : *reg);
+  *old = cur;
+  if (write) {
+    word_t new = (op == CSR_RW ? val : op == CSR_RS ? (cur | val) : (cur & ~val));
+    if (c->write != NULL) c->write(new);
+    else *reg = (*reg & ~c->wmask) | (new & c->wmask);
+    // a pending interrupt may be unmasked
+    event_kick();
+  }
+  return true;
+}
@@ -14,6 +14,17 @@
 ***************************************************************************************/
 
 #include <isa.h>
+#include <plugin.h>
+#include <cpu/event.h>
+#include "../local-include/csr.h"
+
+#define INTR_BIT ((word_t)1 << (sizeof(word_t) * 8 - 1))
+
+// the trap vector, interrupts go to base + 4 * cause in the vectored mode
+static word_t trap_vector(word_t tvec, word_t NO) {
+  word_t base = tvec & ~(word_t)3;
+  return ((tvec & 3) == 1 && (NO & INTR_BIT) ? base + 4 * (NO & ~INTR_BIT) : base);
+}
 
 word_t isa_raise_intr(word_t NO, vaddr_t epc) {
   /* TODO: Trigger an interrupt/exception with ``NO''.
@@ -24,11 +35,61 @@ word_t isa_raise_intr(word_t NO, vaddr_t epc) {
   _Log("\nTrigger an interrupt/exception with NO.%d. PC is 0x%lx\n", (int32_t)NO, epc);
 #endif
 
-  cpu.mcause = 0xb; //environment call from M-mode
+  IFDEF(CONFIG_PLUGIN, if (PLUGIN_ON(PLUGIN_TRAP)) plugin_trap(NO, epc));
+
+  word_t deleg = (NO & INTR_BIT ? cpu.mideleg : cpu.medeleg);
+  if (cpu.priv <= PRV_S && (deleg >> (NO & ~INTR_BIT) & 1)) {
+    // delegated to S-mode
+    cpu.scause = NO;
+    cpu.sepc = epc;
+    cpu.stval = 0;
+    cpu.mstatus = (cpu.mstatus & ~(MSTATUS_SPP | MSTATUS_SPIE | MSTATUS_SIE)) |
+      (cpu.priv == PRV_S ? MSTATUS_SPP : 0) | (cpu.mstatus & MSTATUS_SIE ? MSTATUS_SPIE : 0);
+    cpu.priv = PRV_S;
+    return trap_vector(cpu.stvec, NO);
+  }
+
+  cpu.mcause = NO;
   cpu.mepc = epc;
-  return cpu.mtvec;
+  cpu.mtval = 0;
+  cpu.mstatus = (cpu.mstatus & ~(MSTATUS_MPP | MSTATUS_MPIE | MSTATUS_MIE)) |
+    ((word_t)cpu.priv << MSTATUS_MPP_SHIFT) | (cpu.mstatus & MSTATUS_MIE ? MSTATUS_MPIE : 0);
+  cpu.priv = PRV_M;
+  return trap_vector(cpu.mtvec, NO);
+}
+
+// return to the privilege level before the trap, which is then reset to U-mode
+vaddr_t isa_mret() {
+  cpu.priv = (cpu.mstatus & MSTATUS_MPP) >> MSTATUS_MPP_SHIFT;
+  cpu.mstatus = (cpu.mstatus & ~(MSTATUS_MPP | MSTATUS_MIE)) | MSTATUS_MPIE |
+    (cpu.mstatus & MSTATUS_MPIE ? MSTATUS_MIE : 0);
+  event_kick();
+  return cpu.mepc;
+}
+
+vaddr_t isa_sret() {
+  cpu.priv = (cpu.mstatus & MSTATUS_SPP ? PRV_S : PRV_U);
+  cpu.mstatus = (cpu.mstatus & ~(MSTATUS_SPP | MSTATUS_SIE)) | MSTATUS_SPIE |
+    (cpu.mstatus & MSTATUS_SPIE ? MSTATUS_SIE : 0);
+  event_kick();
+  return cpu.sepc;
 }
 
 word_t isa_query_intr() {
+  word_t pending = cpu.mip & cpu.mie;
+  if (pending == 0) return INTR_EMPTY;
+
+  // interrupts of M-mode are taken in lower levels, or when mstatus.MIE is set
+  word_t m = pending & ~cpu.mideleg;
+  bool m_on = (cpu.priv < PRV_M || (cpu.mstatus & MSTATUS_MIE));
+  word_t s = pending & cpu.mideleg;
+  bool s_on = (cpu.priv < PRV_S || (cpu.priv == PRV_S && (cpu.mstatus & MSTATUS_SIE)));
+  word_t enabled = (m_on ? m : 0) | (s_on ? s : 0);
+
+  // MEI, MSI, MTI, SEI, SSI, STI in order of priority
+  static const int order[] = { 11, 3, 7, 9, 1, 5 };
+  for (int i = 0; i < ARRLEN(order); i ++) {
+    if (enabled >> order[i] & 1) return INTR_BIT | order[i];
+  }
   return INTR_EMPTY;
 }
@@ -0,0 +1,200 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <memory/cache.h>
+
+#ifdef CONFIG_CACHESIM
+
+#define LINE_BITS (__builtin_ctz(CONFIG_CACHE_LINE_SIZE))
+
+/* Tags are packed in one array per cache, `nr_way' entries per set. An
+ * entry is (line number << 2 | DIRTY | VALID), so a lookup compares one
+ * word per way. With LRU, the ways of a set are kept in MRU order: a hit
+ * in the MRU way is a single comparison and the victim is the last way.
+ */
+#define VALID 0x1
+#define DIRTY 0x2
+
+typedef struct Cache {
+  const char *name;
+  int nr_way, set_mask;
+  uint32_t *tag;
+  IFDEF(CONFIG_CACHE_REPL_PLRU, uint64_t *plru); // tree bits of each set
+  struct Cache *next;
+  uint64_t access, miss, eviction, writeback;
+} Cache;
+
+static Cache l1i = { .name = "L1I" };
+static Cache l1d = { .name = "L1D" };
+static Cache l2  = { .name = "L2" };
+
+static void cache_init(Cache *c, int size_kb, int nr_way, Cache *next) {
+  int nr_set = size_kb * 1024 / CONFIG_CACHE_LINE_SIZE / nr_way;
+  Assert(nr_set > 0 && (nr_set & (nr_set - 1)) == 0, "%s: number of sets must be a power of 2", c->name);
+  Assert(nr_way <= 64 && (nr_way & (nr_way - 1)) == 0, "%s: associativity must be a power of 2 no more than 64", c->name);
+  c->nr_way = nr_way;
+  c->set_mask = nr_set - 1;
+  c->tag = calloc(nr_set * nr_way, sizeof(uint32_t));
+  assert(c->tag);
+#ifdef CONFIG_CACHE_REPL_PLRU
+  c->plru = calloc(nr_set, sizeof(uint64_t));
+  assert(c->plru);
+#endif
+  c->next = next;
+  Log("%s cache: %d KB, %d sets, %d ways, %d B lines", c->name, size_kb, nr_set, nr_way, CONFIG_CACHE_LINE_SIZE);
+}
+
+void init_cache() {
+  cache_init(&l2, CONFIG_L2CACHE_SIZE, CONFIG_L2CACHE_WAYS, NULL);
+  cache_init(&l1i, CONFIG_ICACHE_SIZE, CONFIG_ICACHE_WAYS, &l2);
+  cache_init(&l1d, CONFIG_DCACHE_SIZE, CONFIG_DCACHE_WAYS, &l2);
+}
+
+#ifdef CONFIG_CACHE_REPL_PLRU
+// each node of the tree points to the half which holds the victim
+static void plru_touch(Cache *c, uint32_t set, int way) {
+  uint64_t bits = c->plru[set];
+  int node = 1;
+  for (int half = c->nr_way >> 1; half > 0; half >>= 1) {
+    int right = (way & half) != 0;
+    if (right) bits &= ~(1ull << node);
+    else bits |= 1ull << node;
+    node = node * 2 + right;
+  }
+  c->plru[set] = bits;
+}
+
+static int plru_victim(Cache *c, uint32_t set) {
+  uint64_t bits = c->plru[set];
+  int node = 1, way = 0;
+  for (int half = c->nr_way >> 1; half > 0; half >>= 1) {
+    int right = (bits >> node) & 1;
+    if (right) way |= half;
+    node = node * 2 + right;
+  }
+  return way;
+}
+#endif
+
+#ifdef CONFIG_CACHE_REPL_RANDOM
+static uint32_t rand_state = 2463534242u;
+static int random_victim(Cache *c) {
+  rand_state ^= rand_state << 13;
+  rand_state ^= rand_state >> 17;
+  rand_state ^= rand_state << 5;
+  return rand_state & (c->nr_way - 1);
+}
+#endif
+
+static int find_victim(Cache *c, uint32_t set, uint32_t *t) {
+#ifdef CONFIG_CACHE_REPL_LRU
+  return c->nr_way - 1;
+#else
+  for (int w = 0; w < c->nr_way; w ++) {
+    if (!(t[w] & VALID)) return w;
+  }
+  return MUXDEF(CONFIG_CACHE_REPL_PLRU, plru_victim(c, set), random_victim(c));
+#endif
+}
+
+static void touch(Cache *c, uint32_t set, uint32_t *t, int way) {
+#ifdef CONFIG_CACHE_REPL_LRU
+  if (way != 0) {
+    uint32_t e = t[way];
+    memmove(t + 1, t, way * sizeof(t[0]));
+    t[0] = e;
+  }
+#elif defined(CONFIG_CACHE_REPL_PLRU)
+  plru_touch(c, set, way);
+#endif
+}
+
+static void cache_access(Cache *c, uint32_t line, bool is_write) {
+  uint32_t set = line & c->set_mask;
+  uint32_t *t = c->tag + set * c->nr_way;
+  uint32_t key = (line << 2) | VALID;
+  uint32_t dirty = (is_write ? DIRTY : 0);
+  c->access ++;
+
+  for (int w = 0; w < c->nr_way; w ++) {
+    if ((t[w] & ~DIRTY) == key) {
+      t[w] |= dirty;
+      touch(c, set, t, w);
+      return;
+    }
+  }
+
+  c->miss ++;
+  if (c->next != NULL) cache_access(c->next, line, false);
+  int w = find_victim(c, set, t);
+  if (t[w] & VALID) {
+    c->eviction ++;
+    if (t[w] & DIRTY) {
+      c->writeback ++;
+      if (c->next != NULL) cache_access(c->next, t[w] >> 2, true);
+    }
+  }
+  t[w] = key | dirty;
+  touch(c, set, t, w);
+}
+
+void cache_ifetch(paddr_t addr) {
+  cache_access(&l1i, addr >> LINE_BITS, false);
+}
+
+void cache_data(paddr_t addr, bool is_write) {
+  cache_access(&l1d, addr >> LINE_BITS, is_write);
+}
+
+static void invalidate(Cache *c, uint32_t line) {
+  uint32_t *t = c->tag + (line & c->set_mask) * c->nr_way;
+  uint32_t key = (line << 2) | VALID;
+  for (int w = 0; w < c->nr_way; w ++) {
+    if ((t[w] & ~DIRTY) == key) {
+      // keep the MRU order of LRU, the empty way is the victim
+      memmove(t + w, t + w + 1, (c->nr_way - 1 - w) * sizeof(t[0]));
+      t[c->nr_way - 1] = 0;
+      return;
+    }
+  }
+}
+
+void cache_dma(paddr_t addr, size_t len) {
+  if (len == 0) return;
+  for (uint32_t line = addr >> LINE_BITS; line <= (addr + len - 1) >> LINE_BITS; line ++) {
+    invalidate(&l1i, line);
+    invalidate(&l1d, line);
+    invalidate(&l2, line);
+  }
+}
+
+static void report(Cache *c) {
+  Log("%-3s: %" PRIu64 " accesses, %" PRIu64 " misses (%.2f%%), %" PRIu64 " evictions, %" PRIu64 " writebacks",
+      c->name, c->access, c->miss, (c->access == 0 ? 0 : c->miss * 100.0 / c->access),
+      c->eviction, c->writeback);
+}
+
+void cache_report() {
+  report(&l1i);
+  report(&l1d);
+  report(&l2);
+  // one cycle per instruction, plus the stalls of the misses
+  uint64_t cycles = g_nr_guest_inst + (l1i.miss + l1d.miss) * CONFIG_L2CACHE_LATENCY +
+    l2.miss * CONFIG_MEM_LATENCY;
+  Log("estimated cycles = %" PRIu64 ", CPI = %.3f", cycles,
+      (g_nr_guest_inst == 0 ? 0 : (double)cycles / g_nr_guest_inst));
+}
+#endif
@@ -17,13 +17,18 @@
 #include <memory/paddr.h>
 #include <device/mmio.h>
 #include <isa.h>
+#include <cpu/breakpoint.h>
+#include <cpu/difftest.h>
+#include <memory/cache.h>
 
-#if   defined(CONFIG_PMEM_MALLOC)
-static uint8_t *pmem = NULL;
-#else // CONFIG_PMEM_GARRAY
-static uint8_t pmem[CONFIG_MSIZE] PG_ALIGN = {};
+#if defined(CONFIG_PMEM_GARRAY)
+// only the first machine can use the global array
+static uint8_t garray[CONFIG_MSIZE] PG_ALIGN = {};
+static bool garray_taken = false;
 #endif
 
+#define pmem (g_machine->pmem)
+
 uint8_t* guest_to_host(paddr_t paddr) { return pmem + paddr - CONFIG_MBASE; }
 paddr_t host_to_guest(uint8_t *haddr) { return haddr - pmem + CONFIG_MBASE; }
 
@@ -52,14 +57,27 @@ static void display_pwrite(paddr_t addr, int len, word_t data) {
 #endif
 
 void init_mem() {
-#if   defined(CONFIG_PMEM_MALLOC)
-  pmem = malloc(CONFIG_MSIZE);
-  assert(pmem);
+#if defined(CONFIG_PMEM_GARRAY)
+  if (!__atomic_exchange_n(&garray_taken, true, __ATOMIC_RELAXED)) pmem = garray;
+  else
 #endif
+  {
+    pmem = malloc(CONFIG_MSIZE);
+    assert(pmem);
+  }
   IFDEF(CONFIG_MEM_RANDOM, memset(pmem, rand(), CONFIG_MSIZE));
   Log("physical memory area [" FMT_PADDR ", " FMT_PADDR "]", PMEM_LEFT, PMEM_RIGHT);
 }
 
+void free_mem() {
+#if defined(CONFIG_PMEM_GARRAY)
+  if (pmem == garray) { __atomic_store_n(&garray_taken, false, __ATOMIC_RELAXED); }
+  else
+#endif
+  free(pmem);
+  pmem = NULL;
+}
+
 word_t paddr_read(paddr_t addr, int len) {
   IFDEF(CONFIG_MTRACE, display_pread(addr, len));
   if (likely(in_pmem(addr))) return pmem_read(addr, len);
@@ -70,7 +88,16 @@ word_t paddr_read(paddr_t addr, int len) {
 
 void paddr_write(paddr_t addr, int len, word_t data) {
   IFDEF(CONFIG_MTRACE, display_pwrite(addr, len, data));
+  // writes are watched here to also catch the ones not from instructions
+  IFDEF(CONFIG_BREAKPOINT, if (unlikely(nr_mw != 0)) mw_check(addr, len, MW_WRITE));
   if (likely(in_pmem(addr))) { pmem_write(addr, len, data); return; }
   IFDEF(CONFIG_DEVICE, mmio_write(addr, len, data); return);
   out_of_bound(addr);
 }
+
+void paddr_dma(paddr_t addr, size_t len, bool is_write) {
+  IFDEF(CONFIG_BREAKPOINT, if (unlikely(nr_mw != 0)) mw_check(addr, len, (is_write ? MW_WRITE : MW_READ)));
+  if (!is_write) return;
+  IFDEF(CONFIG_CACHESIM, cache_dma(addr, len));
+  difftest_sync_mem(addr, len);
+}
@@ -15,15 +15,28 @@
 
 #include <isa.h>
 #include <memory/paddr.h>
+#include <memory/cache.h>
+#include <cpu/stats.h>
+#include <plugin.h>
+#include <cpu/breakpoint.h>
 
 word_t vaddr_ifetch(vaddr_t addr, int len) {
+  IFDEF(CONFIG_CACHESIM, if (likely(in_pmem(addr))) cache_ifetch(addr));
   return paddr_read(addr, len);
 }
 
 word_t vaddr_read(vaddr_t addr, int len) {
-  return paddr_read(addr, len);
+  IFDEF(CONFIG_STATS, stats_mem(addr, len, false));
+  IFDEF(CONFIG_CACHESIM, if (likely(in_pmem(addr))) cache_data(addr, false));
+  IFDEF(CONFIG_BREAKPOINT, if (unlikely(nr_mw != 0)) mw_check(addr, len, MW_READ));
+  word_t data = paddr_read(addr, len);
+  IFDEF(CONFIG_PLUGIN, if (PLUGIN_ON(PLUGIN_MEM)) plugin_mem(addr, len, false, data));
+  return data;
 }
 
 void vaddr_write(vaddr_t addr, int len, word_t data) {
+  IFDEF(CONFIG_STATS, stats_mem(addr, len, true));
+  IFDEF(CONFIG_CACHESIM, if (likely(in_pmem(addr))) cache_data(addr, true));
+  IFDEF(CONFIG_PLUGIN, if (PLUGIN_ON(PLUGIN_MEM)) plugin_mem(addr, len, true, data));
   paddr_write(addr, len, data);
 }
@@ -0,0 +1,316 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+/* A stub of the GDB remote serial protocol, so that the guest program can
+ * be debugged with `target remote :PORT' in gdb. Only the packets needed
+ * by gdb to read/write registers and memory, set breakpoints/watchpoints,
+ * continue and step are supported.
+ */
+
+#include <isa.h>
+#include <cpu/cpu.h>
+#include <cpu/breakpoint.h>
+#include <memory/paddr.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <unistd.h>
+
+#ifdef CONFIG_GDBSTUB
+
+#define PACKET_SIZE 0x4000
+// instructions executed between two polls of ctrl-c from gdb
+#define POLL_PERIOD (1 << 20)
+
+static int listen_fd = -1, fd = -1;
+
+void init_gdb(int port) {
+  listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  Assert(listen_fd >= 0, "can not create socket");
+  int on = 1;
+  setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  Assert(bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0, "can not bind to port %d", port);
+  Assert(listen(listen_fd, 1) == 0, "can not listen to port %d", port);
+  Log("Waiting for gdb to connect to port %d", port);
+}
+
+static int get_char() {
+  uint8_t c;
+  return (read(fd, &c, 1) == 1 ? c : -1);
+}
+
+static int hex(int c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static const char hexchar[] = "0123456789abcdef";
+
+// receive a packet without "$" and "#xx", return its length or -1 when gdb is gone
+static int get_packet(char *buf) {
+  int c;
+  while (true) {
+    while ((c = get_char()) != '$') {
+      if (c < 0) return -1;
+      // '+' and '-' are acknowledgements, and ctrl-c is meaningless when the CPU is stopped
+    }
+    int len = 0;
+    uint8_t sum = 0;
+    while ((c = get_char()) != '#') {
+      if (c < 0) return -1;
+      if (len < PACKET_SIZE - 1) buf[len ++] = c;
+      sum += c;
+    }
+    int c1 = get_char(), c2 = get_char();
+    if (c1 < 0 || c2 < 0) return -1;
+    bool ok = (hex(c1) << 4 | hex(c2)) == sum;
+    if (write(fd, (ok ? "+" : "-"), 1) != 1) return -1;
+    if (ok) {
+      buf[len] = '\0';
+      return len;
+    }
+  }
+}
+
+static void put_packet(const char *data) {
+  static char buf[PACKET_SIZE + 4];
+  uint8_t sum = 0;
+  int len = 0;
+  buf[len ++] = '$';
+  for (const char *p = data; *p != '\0' && len < PACKET_SIZE; p ++) {
+    buf[len ++] = *p;
+    sum += *p;
+  }
+  buf[len ++] = '#';
+  buf[len ++] = hexchar[sum >> 4];
+  buf[len ++] = hexchar[sum & 0xf];
+  if (write(fd, buf, len) != len) Log("gdb: failed to send a packet");
+}
+
+// registers are sent in target byte order, i.e. little endian
+static char* put_word(char *p, word_t val) {
+  for (int i = 0; i < sizeof(word_t); i ++, val >>= 8) {
+    *p ++ = hexchar[(val >> 4) & 0xf];
+    *p ++ = hexchar[val & 0xf];
+  }
+  return p;
+}
+
+static const char* get_word(const char *p, word_t *val) {
+  *val = 0;
+  for (int i = 0; i < sizeof(word_t) && hex(p[0]) >= 0 && hex(p[1]) >= 0; i ++, p += 2) {
+    *val |= (word_t)(hex(p[0]) << 4 | hex(p[1])) << (i * 8);
+  }
+  return p;
+}
+
+#define NR_GPR ARRLEN(cpu.gpr)
+
+// gdb numbers the registers as gpr[0..NR_GPR-1], pc
+static word_t* reg_ptr(int no) {
+  if (no < NR_GPR) return &cpu.gpr[no];
+  if (no == 32) return &cpu.pc;
+  return NULL;
+}
+
+static void read_regs(char *reply) {
+  char *p = reply;
+  for (int i = 0; i < 32; i ++) p = put_word(p, (i < NR_GPR ? cpu.gpr[i] : 0));
+  p = put_word(p, cpu.pc);
+  *p = '\0';
+}
+
+static void write_regs(const char *p) {
+  for (int i = 0; i <= 32; i ++) {
+    word_t val;
+    p = get_word(p, &val);
+    word_t *r = reg_ptr(i);
+    if (r != NULL) *r = val;
+  }
+  cpu.gpr[0] = 0;
+}
+
+static bool mem_ok(uint64_t addr, uint64_t len) {
+  return addr - CONFIG_MBASE < CONFIG_MSIZE && len <= CONFIG_MSIZE - (addr - CONFIG_MBASE);
+}
+
+static void read_mem(const char *args, char *reply) {
+  uint64_t addr = 0, len = 0;
+  if (sscanf(args, "%" SCNx64 ",%" SCNx64, &addr, &len) != 2 || len > (PACKET_SIZE - 1) / 2 ||
+      (len > 0 && !mem_ok(addr, len))) {
+    strcpy(reply, "E14");
+    return;
+  }
+  uint8_t *host = guest_to_host(addr);
+  char *p = reply;
+  for (uint64_t i = 0; i < len; i ++) {
+    *p ++ = hexchar[host[i] >> 4];
+    *p ++ = hexchar[host[i] & 0xf];
+  }
+  *p = '\0';
+}
+
+static void write_mem(const char *args, char *reply) {
+  uint64_t addr = 0, len = 0;
+  const char *data = strchr(args, ':');
+  if (data == NULL || sscanf(args, "%" SCNx64 ",%" SCNx64, &addr, &len) != 2 ||
+      (len > 0 && !mem_ok(addr, len))) {
+    strcpy(reply, "E14");
+    return;
+  }
+  uint8_t *host = guest_to_host(addr);
+  data ++;
+  for (uint64_t i = 0; i < len; i ++, data += 2) {
+    if (hex(data[0]) < 0 || hex(data[1]) < 0) { strcpy(reply, "E14"); return; }
+    host[i] = hex(data[0]) << 4 | hex(data[1]);
+  }
+  strcpy(reply, "OK");
+}
+
+// Z/z packets: "type,addr,kind"
+static void set_point(const char *args, bool insert, char *reply) {
+  int type = 0;
+  uint64_t addr = 0, kind = 0;
+  if (sscanf(args, "%d,%" SCNx64 ",%" SCNx64, &type, &addr, &kind) != 3) {
+    strcpy(reply, "E01");
+    return;
+  }
+  bool ok;
+  switch (type) {
+    case 0: case 1: // software and hardware breakpoints are the same for us
+      ok = (insert ? bp_insert(addr) : bp_remove(addr));
+      // gdb may insert a breakpoint twice
+      if (insert && !ok) ok = bp_find(addr);
+      break;
+    case 2: case 3: case 4: {
+      int mw_type = (type == 2 ? MW_WRITE : type == 3 ? MW_READ : MW_ACCESS);
+      ok = (insert ? mw_insert(addr, kind, mw_type) : mw_remove(addr, kind, mw_type));
+      break;
+    }
+    default: reply[0] = '\0'; return; // not supported
+  }
+  strcpy(reply, (ok ? "OK" : "E01"));
+}
+
+static bool ctrl_c() {
+  struct pollfd pfd = { .fd = fd, .events = POLLIN };
+  if (poll(&pfd, 1, 0) <= 0) return false;
+  int c = get_char();
+  return c == 0x03;
+}
+
+static void resume(const char *args, uint64_t n, char *reply) {
+  uint64_t addr;
+  if (sscanf(args, "%" SCNx64, &addr) == 1) cpu.pc = addr;
+
+  bp_hit = mw_hit = false;
+  bool interrupted = false;
+  while (n > 0) {
+    uint64_t step = (n < POLL_PERIOD ? n : POLL_PERIOD);
+    cpu_exec(step);
+    n -= step;
+    if (nemu_state.state != NEMU_STOP || bp_hit || mw_hit) break;
+    if (n > 0 && ctrl_c()) { interrupted = true; break; }
+  }
+
+  switch (nemu_state.state) {
+    case NEMU_END: sprintf(reply, "W%02x", nemu_state.halt_ret & 0xff); return;
+    case NEMU_ABORT: case NEMU_QUIT: strcpy(reply, "X06"); return;
+  }
+  if (mw_hit) {
+    sprintf(reply, "T05%s:%" PRIx64 ";",
+        (mw_hit_type == MW_WRITE ? "watch" : mw_hit_type == MW_READ ? "rwatch" : "awatch"),
+        (uint64_t)mw_hit_addr);
+  } else {
+    strcpy(reply, (interrupted ? "S02" : "S05"));
+  }
+}
+
+// return false when the session ends
+static bool handle_packet(char *buf, char *reply) {
+  reply[0] = '\0';
+  char *args = buf + 1;
+  switch (buf[0]) {
+    case '?': strcpy(reply, "S05"); break;
+    case 'g': read_regs(reply); break;
+    case 'G': write_regs(args); strcpy(reply, "OK"); break;
+    case 'p': {
+      word_t *r = reg_ptr(strtol(args, NULL, 16));
+      if (r == NULL) strcpy(reply, "E01");
+      else *put_word(reply, *r) = '\0';
+      break;
+    }
+    case 'P': {
+      char *val;
+      word_t *r = reg_ptr(strtol(args, &val, 16));
+      if (r == NULL || *val != '=') { strcpy(reply, "E01"); break; }
+      get_word(val + 1, r);
+      cpu.gpr[0] = 0;
+      strcpy(reply, "OK");
+      break;
+    }
+    case 'm': read_mem(args, reply); break;
+    case 'M': write_mem(args, reply); break;
+    case 'c': resume(args, -1, reply); break;
+    case 's': resume(args, 1, reply); break;
+    case 'Z': set_point(args, true, reply); break;
+    case 'z': set_point(args, false, reply); break;
+    case 'H': strcpy(reply, "OK"); break;
+    case 'q':
+      if (strncmp(args, "Supported", 9) == 0) sprintf(reply, "PacketSize=%x", PACKET_SIZE);
+      else if (strcmp(args, "Attached") == 0) strcpy(reply, "1");
+      else if (strcmp(args, "C") == 0) strcpy(reply, "QC1");
+      else if (strcmp(args, "fThreadInfo") == 0) strcpy(reply, "m1");
+      else if (strcmp(args, "sThreadInfo") == 0) strcpy(reply, "l");
+      break;
+    case 'D': put_packet("OK"); return false;
+    case 'k': nemu_state.state = NEMU_QUIT; return false;
+    default: break; // an empty reply means the packet is not supported
+  }
+  put_packet(reply);
+  return true;
+}
+
+bool gdb_mainloop() {
+  if (listen_fd < 0) return false;
+
+  fd = accept(listen_fd, NULL, NULL);
+  Assert(fd >= 0, "failed to accept the connection from gdb");
+  int on = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  Log("gdb is connected");
+
+  static char buf[PACKET_SIZE], reply[PACKET_SIZE + 4];
+  bool alive = true;
+  while (alive && get_packet(buf) >= 0) {
+    alive = handle_packet(buf, reply);
+  }
+  close(fd);
+  close(listen_fd);
+
+  // gdb has detached or is gone, run to the end; breakpoints left by
+  // a killed gdb are passed through
+  while (nemu_state.state == NEMU_STOP) cpu_exec(-1);
+  return true;
+}
+#endif
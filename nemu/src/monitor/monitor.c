@@ -16,17 +16,20 @@
 #include <isa.h>
 #include <memory/paddr.h>
 #include <cpu/cpu.h>
+#include <cpu/bpred.h>
+#include <cpu/coverage.h>
+#include <plugin.h>
 #include <elf.h>
 
-struct func_info *func_table = NULL;
-size_t func_table_size = 0;
-
 void init_rand();
 void init_log(const char *log_file);
 void init_mem();
+void init_cache();
 void init_difftest(char *ref_so_file, long img_size, int port);
 void init_device();
+void init_replay(const char *record_file, const char *replay_file);
 void init_sdb();
+void init_gdb(int port);
 void init_disasm(const char *triple);
 
 static void welcome() {
@@ -45,11 +48,21 @@ static void welcome() {
 #include <getopt.h>
 
 void sdb_set_batch_mode();
+void sdb_set_script(const char *file);
+void sdb_set_json(const char *file);
 
 static char *log_file = NULL;
 static char *diff_so_file = NULL;
 static char *img_file = NULL;
 static char *elf_file = NULL;
+static char *profile_file = NULL;
+static char *coverage_file = NULL;
+static char *bbv_file = NULL;
+static char *record_file = NULL;
+static char *replay_file = NULL;
+static char *plugin_spec[8] = {};
+static int nr_plugin = 0;
+static int gdb_port = 0;
 static int difftest_port = 1234;
 
 static long load_img() {
@@ -74,6 +87,11 @@ static long load_img() {
   return size;
 }
 
+static int func_info_cmp(const void *a, const void *b) {
+  word_t x = ((const struct func_info *)a)->func_start, y = ((const struct func_info *)b)->func_start;
+  return (x > y) - (x < y);
+}
+
 static void load_elf() {
   if (elf_file == NULL) {
     Log("No elf is given. Can npt build symbol table.");
@@ -197,6 +215,8 @@ static void load_elf() {
       idx++;
     }
   }
+  // sorted by address for the binary search in find_func_name()
+  qsort(func_table, idx, sizeof(struct func_info), func_info_cmp);
   // ??? for the case if do not find the func name match
   strcpy(func_table[idx].func_name, "???");
   func_table[idx].func_start = 0;
@@ -213,14 +233,35 @@ static int parse_args(int argc, char *argv[]) {
     {"diff"     , required_argument, NULL, 'd'},
     {"port"     , required_argument, NULL, 'p'},
     {"elf"      , required_argument, NULL, 'e'},
+    {"profile"  , required_argument, NULL, 'f'},
+    {"coverage" , required_argument, NULL, 'C'},
+    {"bbv"      , required_argument, NULL, 'B'},
+    {"plugin"   , required_argument, NULL, 'P'},
+    {"gdb"      , required_argument, NULL, 'g'},
+    {"script"   , required_argument, NULL, 'S'},
+    {"json"     , optional_argument, NULL, 'j'},
+    {"record"   , required_argument, NULL, 'r'},
+    {"replay"   , required_argument, NULL, 'R'},
     {"help"     , no_argument      , NULL, 'h'},
     {0          , 0                , NULL,  0 },
   };
   int o;
-  while ( (o = getopt_long(argc, argv, "-bhl:d:p:s:", table, NULL)) != -1) {
+  while ( (o = getopt_long(argc, argv, "-bhl:d:p:s:e:f:C:B:P:g:S:j::r:R:", table, NULL)) != -1) {
     switch (o) {
       case 'b': sdb_set_batch_mode(); break;
       case 'e': elf_file = optarg; break;
+      case 'f': profile_file = optarg; break;
+      case 'C': coverage_file = optarg; break;
+      case 'B': bbv_file = optarg; break;
+      case 'g': sscanf(optarg, "%d", &gdb_port); break;
+      case 'S': sdb_set_script(optarg); break;
+      case 'j': sdb_set_json(optarg); break;
+      case 'r': record_file = optarg; break;
+      case 'R': replay_file = optarg; break;
+      case 'P':
+        Assert(nr_plugin < ARRLEN(plugin_spec), "too many plugins");
+        plugin_spec[nr_plugin ++] = optarg;
+        break;
       case 'p': sscanf(optarg, "%d", &difftest_port); break;
       case 'l': log_file = optarg; break;
       case 'd': diff_so_file = optarg; break;
@@ -232,6 +273,15 @@ static int parse_args(int argc, char *argv[]) {
         printf("\t-d,--diff=REF_SO        run DiffTest with reference REF_SO\n");
         printf("\t-p,--port=PORT          run DiffTest with port PORT\n");
         printf("\t-e,--elf=FILE_ELF       read the FILE_ELF\n");
+        printf("\t-f,--profile=FILE       write the folded call stacks of the profiler to FILE\n");
+        printf("\t-C,--coverage=FILE      map the basic block coverage bitmap to FILE\n");
+        printf("\t-B,--bbv=FILE           write the basic block vectors for SimPoint to FILE\n");
+        printf("\t-P,--plugin=SO[,ARGS]   load the instrumentation plugin SO with ARGS\n");
+        printf("\t-g,--gdb=PORT           wait for gdb to connect to PORT instead of running sdb\n");
+        printf("\t-S,--script=FILE        run the sdb commands in FILE instead of reading stdin\n");
+        printf("\t-j,--json[=FILE]        output the results of sdb commands as JSON lines to FILE or stdout\n");
+        printf("\t-r,--record=FILE        record the nondeterministic inputs of devices to FILE\n");
+        printf("\t-R,--replay=FILE        replay the inputs of devices recorded in FILE\n");
         printf("\n");
         exit(0);
     }
@@ -254,9 +304,19 @@ void init_monitor(int argc, char *argv[]) {
   /* Initialize memory. */
   init_mem();
 
+  /* Initialize the cache simulator. */
+  IFDEF(CONFIG_CACHESIM, init_cache());
+
   /* Initialize devices. */
   IFDEF(CONFIG_DEVICE, init_device());
 
+  /* Record or replay the inputs of devices. */
+#ifdef CONFIG_RECORD_REPLAY
+  init_replay(record_file, replay_file);
+#else
+  if (record_file != NULL || replay_file != NULL) Log("Record/replay is not supported, please enable CONFIG_RECORD_REPLAY");
+#endif
+
   /* Perform ISA dependent initialization. */
   init_isa();
 
@@ -269,9 +329,47 @@ void init_monitor(int argc, char *argv[]) {
   /* Read the elf file to get the symbol table. */
   load_elf();
 
+  /* Initialize the profiler with the symbol table. */
+#ifdef CONFIG_PROFILE
+  init_profile(profile_file);
+#else
+  if (profile_file != NULL) Log("Profiler is not supported, please enable CONFIG_PROFILE");
+#endif
+
+  /* Initialize the coverage bitmap. */
+#ifdef CONFIG_COVERAGE
+  init_coverage(coverage_file);
+#else
+  if (coverage_file != NULL) Log("Coverage is not supported, please enable CONFIG_COVERAGE");
+#endif
+
+  /* Open the file of basic block vectors. */
+#ifdef CONFIG_BBV
+  init_bbv(bbv_file);
+#else
+  if (bbv_file != NULL) Log("BBV is not supported, please enable CONFIG_BBV");
+#endif
+
+  /* Initialize the branch predictors. */
+  IFDEF(CONFIG_BPRED, init_bpred());
+
+  /* Load the plugins. */
+#ifdef CONFIG_PLUGIN
+  for (int i = 0; i < nr_plugin; i ++) init_plugin(plugin_spec[i]);
+#else
+  if (nr_plugin > 0) Log("Plugins are not supported, please enable CONFIG_PLUGIN");
+#endif
+
   /* Initialize the simple debugger. */
   init_sdb();
 
+  /* Listen to gdb. */
+#ifdef CONFIG_GDBSTUB
+  if (gdb_port != 0) init_gdb(gdb_port);
+#else
+  if (gdb_port != 0) Log("GDB stub is not supported, please enable CONFIG_GDBSTUB");
+#endif
+
 #ifndef CONFIG_ISA_loongarch32r
   IFDEF(CONFIG_ITRACE, init_disasm(
     MUXDEF(CONFIG_ISA_x86,     "i686",
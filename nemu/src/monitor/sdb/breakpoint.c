@@ -0,0 +1,158 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+/* Breakpoints of sdb. The pc is put into the hash set of cpu/breakpoint,
+ * which stops the CPU; conditions and hit counts are handled here after
+ * the CPU stops.
+ */
+
+#include <isa.h>
+#include <cpu/cpu.h>
+#include <cpu/breakpoint.h>
+#include "sdb.h"
+
+#ifdef CONFIG_BREAKPOINT
+
+static BP *head = NULL;
+static int next_no = 1;
+
+static BP* find_bp(vaddr_t pc) {
+  for (BP *p = head; p != NULL; p = p->next) {
+    if (p->pc == pc) return p;
+  }
+  return NULL;
+}
+
+static const char* func_of(vaddr_t pc) {
+  return (func_table != NULL ? func_table[find_func_name(pc)].func_name : "???");
+}
+
+/* LOC is a function name, `*EXPR' or EXPR */
+static bool resolve(char *loc, vaddr_t *pc) {
+  if (func_table != NULL && loc[0] != '*') {
+    // the last entry is "???"
+    for (size_t i = 0; i + 1 < func_table_size; i ++) {
+      if (strcmp(func_table[i].func_name, loc) == 0) {
+        *pc = func_table[i].func_start;
+        return true;
+      }
+    }
+  }
+
+  bool success = true;
+  *pc = expr(loc + (loc[0] == '*'), &success);
+  return success;
+}
+
+// return the number of the new breakpoint, or 0 on failure
+int bp_add(char *loc, char *cond) {
+  vaddr_t pc;
+  if (!resolve(loc, &pc)) {
+    printf("Can not find the location '%s'\n", loc);
+    return 0;
+  }
+  if (find_bp(pc) != NULL) {
+    printf("There is already a breakpoint at " FMT_WORD "\n", pc);
+    return 0;
+  }
+
+  BP *bp = calloc(1, sizeof(BP));
+  assert(bp);
+  if (cond != NULL) {
+    if (!expr_compile(cond, &bp->cond)) {
+      printf("EXPR error!\n");
+      expr_free(&bp->cond);
+      free(bp);
+      return 0;
+    }
+    strncpy(bp->cond_buf, cond, sizeof(bp->cond_buf) - 1);
+  }
+  if (!bp_insert(pc)) {
+    printf("Too many breakpoints!\n");
+    expr_free(&bp->cond);
+    free(bp);
+    return 0;
+  }
+
+  bp->NO = next_no ++;
+  bp->pc = pc;
+  bp->next = head;
+  head = bp;
+  printf("Breakpoint %d at " FMT_WORD " <%s>\n", bp->NO, pc, func_of(pc));
+  return bp->NO;
+}
+
+bool bp_delete(int no) {
+  for (BP **pp = &head; *pp != NULL; pp = &(*pp)->next) {
+    BP *bp = *pp;
+    if (bp->NO == no) {
+      *pp = bp->next;
+      bp_remove(bp->pc);
+      expr_free(&bp->cond);
+      free(bp);
+      return true;
+    }
+  }
+  return false;
+}
+
+/* The CPU stops before the instruction at a breakpoint. Return 0 to
+ * resume, or the number of the breakpoint to stay stopped, i.e. the
+ * condition holds or can not be evaluated.
+ */
+int bp_check_cond() {
+  BP *bp = find_bp(cpu.pc);
+  if (bp == NULL) return -1;
+
+  if (bp->cond_buf[0] != '\0') {
+    bool success = true;
+    word_t val = expr_run(&bp->cond, &success);
+    if (!success) {
+      printf("Error in the condition of breakpoint %d: %s\n", bp->NO, bp->cond_buf);
+    } else if (val == 0) {
+      return 0;
+    }
+  }
+
+  bp->hits ++;
+  printf("Breakpoint %d, " FMT_WORD " in %s ()\n", bp->NO, bp->pc, func_of(bp->pc));
+  return bp->NO;
+}
+
+void bp_display() {
+  if (head == NULL) {
+    printf("No breakpoints!\n");
+    return;
+  }
+
+  printf("%-8s%-20s%-10s%-20s%s\n", "No", "ADDR", "HITS", "FUNC", "COND");
+  for (BP *p = head; p != NULL; p = p->next) {
+    printf("%-8d" FMT_WORD "  %-10" PRIu64 "%-20s%s\n", p->NO, p->pc, p->hits, func_of(p->pc), p->cond_buf);
+  }
+}
+
+void bp_display_json(FILE *fp) {
+  fputs(",\"breakpoints\":[", fp);
+  for (BP *p = head; p != NULL; p = p->next) {
+    fprintf(fp, "%s{\"no\":%d,\"pc\":\"" FMT_WORD "\",\"hits\":%" PRIu64 ",\"func\":",
+        (p == head ? "" : ","), p->NO, p->pc, p->hits);
+    json_str(fp, func_of(p->pc));
+    fputs(",\"cond\":", fp);
+    json_str(fp, p->cond_buf);
+    fputc('}', fp);
+  }
+  fputc(']', fp);
+}
+#endif
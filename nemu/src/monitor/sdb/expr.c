@@ -14,356 +14,303 @@
 ***************************************************************************************/
 
 #include <isa.h>
-
-/* We use the POSIX regex functions to process regular expressions.
- * Type 'man regex' for more information about POSIX regex functions.
- */
-#include <regex.h>
+#include <utils.h>
 #include "memory/vaddr.h"
 #include "memory/paddr.h"
+#include "sdb.h"
 
 enum {
-  TK_NOTYPE = 256, TK_EQ, TK_NEQ, TK_AND, TK_OR, TK_GRE_EQ, TK_LESS_EQ, TK_INT, TK_REG, TK_VAR, TK_POSITIVE, TK_NEGATIVE, TK_DEREF
+  TK_NOTYPE = 256, TK_EQ, TK_NEQ, TK_AND, TK_OR, TK_GRE_EQ, TK_LESS_EQ, TK_INT, TK_REG, TK_VAR, TK_POSITIVE, TK_NEGATIVE, TK_DEREF,
 
   /* TODO: Add more token types */
 
+  TK_END
 };
 
-static struct rule {
-  const char *regex;
-  int token_type;
-} rules[] = {
-
-  /* TODO: Add more rules.
-   * Pay attention to the precedence level of different rules.
-   */
-
-  {" +", TK_NOTYPE},    // spaces
-  {"\\+", '+'},         // plus
-  {"\\-", '-'},         // minus
-  {"\\*", '*'},         // multiplication
-  {"\\/", '/'},         // division
-  {"%%", '%'},          // mod
-  {"\\(", '('},         // left parentheses
-  {"\\)", ')'},         // right parentheses
-  {"==", TK_EQ},        // equal
-  {"!=", TK_NEQ},       // not equal
-  {"&&", TK_AND},       // and
-  {"\\|\\|", TK_OR},    // or
-  {"!", '!'},           // not
-  {">", '>'},           // greater 
-  {">=", TK_GRE_EQ},    // greater or equal to
-  {"<", '<'},           // less
-  {"<=", TK_LESS_EQ},   // less than or equal to
-  {"&", '&'},           // bitwise and
-  {"\\|", '|'},         // bitwise or
-  {"\\^", '^'},         // bitwise xor
-  {"~", '~'},           // bitwise inversion
-  {"(0x)?[0-9a-f]+", TK_INT},   // decimal or hexadecimal number
-  {"[\\$][a-z0-9]{1,3}", TK_REG}, // register
-  {"[A-Za-z_]\\w*", TK_VAR} // variable
-};
-
-static struct op_rank {
-  int token_type;
-  int rank;
-} op_ranks[] = {
-  {TK_NEGATIVE, 2},
-  {TK_POSITIVE, 2},
-  {TK_DEREF, 2},
-  {'!', 2},
-  {'~', 2},
-  {'*', 3},
-  {'/', 3},
-  {'%', 3},
-  {'+', 4},
-  {'-', 4},
-  {'>', 6},
-  {TK_GRE_EQ, 6},
-  {'<', 6},
-  {TK_LESS_EQ, 6},
-  {TK_EQ, 7},
-  {TK_NEQ, 7},
-  {'&', 8},
-  {'^', 9},
-  {'|', 10},
-  {TK_AND, 11},
-  {TK_OR, 12},
+/* The smaller the rank, the tighter the operator binds.
+ * Unary operators are ranked 2, binary operators are ranked 3 and above.
+ */
+static const uint8_t op_ranks[TK_END] = {
+  [TK_NEGATIVE] = 2, [TK_POSITIVE] = 2, [TK_DEREF] = 2, ['!'] = 2, ['~'] = 2,
+  ['*'] = 3, ['/'] = 3, ['%'] = 3,
+  ['+'] = 4, ['-'] = 4,
+  ['>'] = 6, [TK_GRE_EQ] = 6, ['<'] = 6, [TK_LESS_EQ] = 6,
+  [TK_EQ] = 7, [TK_NEQ] = 7,
+  ['&'] = 8,
+  ['^'] = 9,
+  ['|'] = 10,
+  [TK_AND] = 11,
+  [TK_OR] = 12,
 };
 
-#define NR_REGEX ARRLEN(rules)
-
-static regex_t re[NR_REGEX] = {};
+#define is_binary_operator(type) (op_ranks[type] > 2)
 
-/* Rules are used for many times.
- * Therefore we compile them only once before any usage.
+/* Tokens point into the expression instead of copying it. The array is an
+ * arena reused by every expression, and grows with the longest one.
  */
-void init_regex() {
-  int i;
-  char error_msg[128];
-  int ret;
-
-  for (i = 0; i < NR_REGEX; i ++) {
-    ret = regcomp(&re[i], rules[i].regex, REG_EXTENDED);
-    if (ret != 0) {
-      regerror(ret, &re[i], error_msg, 128);
-      panic("regex compilation failed: %s\n%s", error_msg, rules[i].regex);
-    }
-  }
-}
-
 typedef struct token {
   int type;
-  char str[32];
+  const char *str;
+  int len;
 } Token;
 
-static Token tokens[32] __attribute__((used)) = {};
-static int nr_token __attribute__((used))  = 0;
+static Token *tokens = NULL;
+static int nr_token = 0, max_token = 0;
+// operator stack of the parser, as large as `tokens'
+static int *op_stack = NULL;
 
-static word_t eval(int start, int end, bool *success);
-static bool is_big_parentheses(int start, int end);
-static bool check_parentheses(int start, int end);
-static int find_primary_op(int start, int end);
-static bool switch_to_unary_operator();
 static word_t calc1(int op, word_t val2, bool *success);
 static word_t calc2(word_t val1, int op, word_t val2, bool *success);
-static int get_op_rank(int op);
-static bool is_unary_operator(int op);
 
-static bool make_token(char *e) {
-  int position = 0;
-  int i;
-  regmatch_t pmatch;
+static Token* new_token(int type, const char *str, int len) {
+  if (nr_token == max_token) {
+    max_token = (max_token == 0 ? 64 : max_token * 2);
+    tokens = realloc(tokens, sizeof(Token) * max_token);
+    op_stack = realloc(op_stack, sizeof(int) * max_token);
+    assert(tokens && op_stack);
+  }
+  Token *t = &tokens[nr_token ++];
+  t->type = type;
+  t->str = str;
+  t->len = len;
+  return t;
+}
+
+/* <ctype.h> looks up the locale on every call, which is too slow here */
+static inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+static inline bool is_lower(char c) { return c >= 'a' && c <= 'z'; }
+static inline bool is_alpha(char c) { return is_lower(c | 0x20); }
+static inline bool is_hex(char c) { return is_digit(c) || ((c | 0x20) >= 'a' && (c | 0x20) <= 'f'); }
+static inline bool is_word(char c) { return is_alpha(c) || is_digit(c) || c == '_'; }
 
+/* Scan the expression once, looking at most one character ahead. */
+static bool make_token(char *e) {
   nr_token = 0;
 
-  while (e[position] != '\0') {
-    /* Try all rules one by one. */
-    for (i = 0; i < NR_REGEX; i ++) {
-      if (regexec(&re[i], e + position, 1, &pmatch, 0) == 0 && pmatch.rm_so == 0) {
-        char *substr_start = e + position;
-        int substr_len = pmatch.rm_eo;
-
-        Log("match rules[%d] = \"%s\" at position %d with len %d: %.*s",
-            i, rules[i].regex, position, substr_len, substr_len, substr_start);
-
-        position += substr_len;
-
-        /* TODO: Now a new token is recognized with rules[i]. Add codes
-         * to record the token in the array `tokens'. For certain types
-         * of tokens, some extra actions should be performed.
-         */
-
-        if (rules[i].token_type == TK_NOTYPE) break;
-
-        tokens[nr_token].type = rules[i].token_type;
-        switch (rules[i].token_type) {
-          case TK_INT:
-          case TK_REG:
-          case TK_VAR:
-            if (substr_len >= 32) {
-              printf("token too long, should less than 32: %*.s\n", substr_len, substr_start);
-              return false;
-            } else {
-              strncpy(tokens[nr_token].str, substr_start, substr_len);
-              tokens[nr_token].str[substr_len] = '\0';
-            }
-            break;
-          case '+':
-            if (switch_to_unary_operator() == true) {
-              /* positive number */
-              tokens[nr_token].type = TK_POSITIVE;
-            }
-            break;
-          case '-':
-            if (switch_to_unary_operator() == true) {
-              /* negative number */
-              tokens[nr_token].type = TK_NEGATIVE;
-            }
-            break;
-          case '*':
-            if (switch_to_unary_operator() == true) {
-              /* "*" mean dereference */
-              tokens[nr_token].type = TK_DEREF;
-            }
-            break;
-          case '/': case '%': case '(': case ')': case TK_EQ: case TK_NEQ: case TK_AND: case TK_OR: case '!': case '>': case TK_GRE_EQ: case '<': case TK_LESS_EQ: case '&': case '|': case '^': case '~':
-            break;
-          default:
-            panic("token type %d is not implement\n", rules[i].token_type);
-        }
-        nr_token++;
+  for (char *p = e; *p != '\0'; ) {
+    int type = *p, len = 1;
+    switch (*p) {
+      case ' ': case '\t':
+        p ++;
+        continue;
+      case '+': case '-': case '*': case '/': case '%': case '(': case ')': case '^': case '~':
         break;
-      }
+      case '=':
+        if (p[1] != '=') goto bad;
+        type = TK_EQ; len = 2;
+        break;
+      case '!':
+        if (p[1] == '=') { type = TK_NEQ; len = 2; }
+        break;
+      case '&':
+        if (p[1] == '&') { type = TK_AND; len = 2; }
+        break;
+      case '|':
+        if (p[1] == '|') { type = TK_OR; len = 2; }
+        break;
+      case '>':
+        if (p[1] == '=') { type = TK_GRE_EQ; len = 2; }
+        break;
+      case '<':
+        if (p[1] == '=') { type = TK_LESS_EQ; len = 2; }
+        break;
+      case '$':
+        /* register: "$" followed by at most 3 characters */
+        type = TK_REG;
+        while (len <= 3 && (is_lower(p[len]) || is_digit(p[len]))) len ++;
+        if (len == 1) goto bad;
+        break;
+      default:
+        if (is_digit(*p)) {
+          /* decimal or hexadecimal number */
+          type = TK_INT;
+          if (p[0] == '0' && p[1] == 'x' && is_hex(p[2])) {
+            for (len = 2; is_hex(p[len]); len ++);
+          } else {
+            for (len = 0; is_digit(p[len]); len ++);
+          }
+        } else if (is_alpha(*p) || *p == '_') {
+          type = TK_VAR;
+          while (is_word(p[len])) len ++;
+        } else {
+          goto bad;
+        }
     }
+    new_token(type, p, len);
+    p += len;
+    continue;
 
-    if (i == NR_REGEX) {
-      printf("no match at position %d\n%s\n%*.s^\n", position, e, position, "");
-      return false;
-    }
+bad:
+    printf("no match at position %d\n%s\n%*.s^\n", (int)(p - e), e, (int)(p - e), "");
+    return false;
   }
 
   return true;
 }
 
-
 word_t expr(char *e, bool *success) {
-  if (!make_token(e)) {
+  // reused by every call, so only a longer expression allocates
+  static ExprCode code = {};
+  if (!expr_compile(e, &code)) {
     *success = false;
     return 0;
   }
 
-  /* TODO: Insert codes to evaluate the expression. */
-  return eval(0, nr_token - 1, success);
+  return expr_run(&code, success);
 }
 
-static word_t eval(int start, int end, bool *success) {
-  if (*success == false) {
-    return 0;
+static void emit(ExprCode *code, int op, int stack_delta) {
+  if (code->n == code->max) {
+    code->max = (code->max == 0 ? 16 : code->max * 2);
+    code->inst = realloc(code->inst, sizeof(ExprInst) * code->max);
+    assert(code->inst);
   }
+  code->inst[code->n ++].op = op;
+  code->sp += stack_delta;
+  if (code->sp > code->depth) code->depth = code->sp;
+}
 
-  if (start > end) {
-    *success = false;
-  } else if (start == end) {
-    word_t val = 0;
-    switch (tokens[start].type) {
-      case TK_INT:
-        /* <expr> ::= <decimal or hexadecimal number> */
-        if (strlen(tokens[start].str) > 2 && tokens[start].str[1] == 'x') {
-          sscanf(tokens[start].str, "%lx", &val);
-        } else {
-          sscanf(tokens[start].str, "%ld", &val);
+static bool emit_operand(ExprCode *code, const Token *t) {
+  emit(code, t->type, 1);
+  ExprInst *inst = &code->inst[code->n - 1];
+  switch (t->type) {
+    case TK_INT:
+      /* <expr> ::= <decimal or hexadecimal number> */
+      inst->val = 0;
+      if (t->len > 2 && t->str[1] == 'x') {
+        for (int i = 2; i < t->len; i ++) {
+          char c = t->str[i] | 0x20;
+          inst->val = inst->val * 16 + (is_digit(c) ? c - '0' : c - 'a' + 10);
         }
-        break;
-      case TK_REG:
-        val = isa_reg_str2val(tokens[start].str, success);
-        break;
-      case TK_VAR:
-        TODO();
-        break;
-      default:
-        *success = false;
-    }
-    return val;
-  } else if (check_parentheses(start, end) == false)  {
-    /* parentheses is illegal */
-    *success = false;
-    return 0;
-  } else if (is_big_parentheses(start, end) == true) {
-    /* <expr> ::= "(" <expr> ")" */
-    return eval(start + 1, end - 1, success);
-  } else {
-    /*  <expr> ::= <expr> "+" <expr>
-          | <expr> "-" <expr>
-          | <expr> "*" <expr>
-          | <expr> "/" <expr>
-          | <expr> "%" <expr>
-          | <expr> "==" <expr>
-          | <expr> "!=" <expr>
-          | <expr> "&&" <expr>
-          | <expr> "||" <expr>
-          | <expr> ">" <expr>
-          | <expr> ">=" <expr>
-          | <expr> "<" <expr>
-          | <expr> "<=" <expr>
-          | <expr> "&" <expr>
-          | <expr> "|" <expr>
-          | <expr> "^" <expr>
-          | "~" <expr>
-          | "+" <expr>
-          | "-" <expr>
-          | "*" <expr>              # dereference pointer
-    */
-    int op = find_primary_op(start, end);
-
-    bool ok1 = true, ok2 = true;
-    word_t val1 = eval(start, op - 1, &ok1);
-    word_t val2 = eval(op + 1, end, &ok2);
-
-    if (ok2 == false) {
-      *success = false;
+      } else {
+        for (int i = 0; i < t->len; i ++) {
+          inst->val = inst->val * 10 + (t->str[i] - '0');
+        }
+      }
+      return true;
+    case TK_REG: {
+      /* look up the register now to reject a wrong name */
+      bool success = true;
+      memcpy(inst->reg, t->str, t->len);
+      inst->reg[t->len] = '\0';
+      isa_reg_str2val(inst->reg, &success);
+      return success;
     }
+    default:
+      printf("symbols are not supported: %.*s\n", t->len, t->str);
+      return false;
+  }
+}
 
-    if (ok1 == true) {
-      return calc2(val1, tokens[op].type, val2, success);
+/* Watchpoints are evaluated after every instruction, so the expression is
+ * lexed and parsed only once here into a postfix code.
+ *
+ * The parser is the shunting-yard algorithm: operands are emitted at once,
+ * and an operator waits on `op_stack' until an operator which binds looser
+ * comes. Binary operators are left associative, and unary operators are
+ * prefix ones.
+ */
+bool expr_compile(char *e, ExprCode *code) {
+  if (!make_token(e)) {
+    return false;
+  }
+
+  code->n = code->sp = code->depth = 0;
+  int top = 0;
+  bool want_operand = true;
+
+  for (int i = 0; i < nr_token; i ++) {
+    const Token *t = &tokens[i];
+    if (want_operand) {
+      switch (t->type) {
+        /* "+", "-" and "*" without a left operand are unary */
+        case '+': op_stack[top ++] = TK_POSITIVE; break;
+        case '-': op_stack[top ++] = TK_NEGATIVE; break;
+        case '*': op_stack[top ++] = TK_DEREF; break;
+        case '!': case '~': case '(': op_stack[top ++] = t->type; break;
+        case TK_INT: case TK_REG: case TK_VAR:
+          if (!emit_operand(code, t)) return false;
+          want_operand = false;
+          break;
+        default: return false;
+      }
+    } else if (t->type == ')') {
+      while (top > 0 && op_stack[top - 1] != '(') {
+        int op = op_stack[-- top];
+        emit(code, op, (is_binary_operator(op) ? -1 : 0));
+      }
+      if (top == 0) return false;
+      top --;
+    } else if (is_binary_operator(t->type)) {
+      while (top > 0 && op_stack[top - 1] != '(' && op_ranks[op_stack[top - 1]] <= op_ranks[t->type]) {
+        int op = op_stack[-- top];
+        emit(code, op, (is_binary_operator(op) ? -1 : 0));
+      }
+      op_stack[top ++] = t->type;
+      want_operand = true;
     } else {
-      return calc1(tokens[op].type, val2, success);
+      return false;
     }
   }
 
-  return 0;
+  if (want_operand) {
+    return false;
+  }
+  while (top > 0) {
+    int op = op_stack[-- top];
+    if (op == '(') return false;
+    emit(code, op, (is_binary_operator(op) ? -1 : 0));
+  }
+  return true;
 }
 
-static bool is_big_parentheses(int start, int end) {
-  if (tokens[start].type != '(' || tokens[end].type != ')') return false;
-  return check_parentheses(start + 1, end - 1);
+void expr_free(ExprCode *code) {
+  free(code->inst);
+  code->inst = NULL;
+  code->n = code->max = 0;
 }
 
-static bool check_parentheses(int start, int end) {
-  int left_parentheses_cnt = 0;
+word_t expr_run(const ExprCode *code, bool *success) {
+  word_t stack[code->depth];
+  int sp = 0;
 
-  left_parentheses_cnt = 0;
-  for (int i = start; i <= end && left_parentheses_cnt >= 0; i++) {
-    switch (tokens[i].type) {
-      case '(':
-        left_parentheses_cnt++;
+  for (int i = 0; i < code->n; i ++) {
+    const ExprInst *inst = &code->inst[i];
+    switch (inst->op) {
+      case TK_INT:
+        stack[sp ++] = inst->val;
         break;
-      case ')':
-        left_parentheses_cnt--;
+      case TK_REG:
+        stack[sp ++] = isa_reg_str2val(inst->reg, success);
         break;
-      default:
+      case TK_POSITIVE: case TK_NEGATIVE: case TK_DEREF: case '!': case '~':
+        stack[sp - 1] = calc1(inst->op, stack[sp - 1], success);
         break;
+      default:
+        sp --;
+        stack[sp - 1] = calc2(stack[sp - 1], inst->op, stack[sp], success);
     }
   }
-  if (left_parentheses_cnt != 0) return false;
-
-  return true;
-}
-
-static int find_primary_op(int start, int end) {
-  int left_parentheses = 0;
-  int op_pos = -1, op_rank = 0;
 
-  for (int i = start; i <= end; i++) {
-    if (left_parentheses > 0) {
-      if (tokens[i].type == '(') {
-        left_parentheses++;
-      } else if (tokens[i].type == ')') {
-        left_parentheses--;
-      }
-      continue;
-    }
-
-    if (tokens[i].type == '(') {
-      left_parentheses++;
-      continue;
-    }
-
-    int cur_op_rank = get_op_rank(tokens[i].type);
-    if (cur_op_rank > op_rank || (cur_op_rank == op_rank && is_unary_operator(tokens[i].type) == false)) {
-      op_pos = i;
-      op_rank = cur_op_rank;
-    }
-
-  }
-  return op_pos;
+  return stack[0];
 }
 
-static bool switch_to_unary_operator() {
-  if (nr_token == 0) {
-    return true;
+/* Is the code `*ADDR' with a constant ADDR? */
+bool expr_mem_addr(const ExprCode *code, vaddr_t *addr) {
+  if (code->n < 2 || code->inst[code->n - 1].op != TK_DEREF) {
+    return false;
   }
-
-  switch (tokens[nr_token-1].type) {
-    case ')':
-    case TK_INT:
-    case TK_REG:
-    case TK_VAR:
+  for (int i = 0; i < code->n - 1; i ++) {
+    if (code->inst[i].op == TK_REG || code->inst[i].op == TK_DEREF) {
       return false;
-    default:
-      return true;
+    }
   }
-  return false;
+
+  ExprCode tmp = *code;
+  bool success = true;
+  tmp.n --;
+  *addr = expr_run(&tmp, &success);
+  return success && in_pmem(*addr);
 }
 
 static word_t calc1(int op, word_t val2, bool *success) {
@@ -399,8 +346,12 @@ static word_t calc2(word_t val1, int op, word_t val2, bool *success) {
     case '+': return val1 + val2;
     case '-': return val1 - val2;
     case '*': return val1 * val2;
-    case '/': return (sword_t)val1 / (sword_t)val2;
-    case '%': return val1 % val2;
+    case '/': case '%':
+      if (val2 == 0) {
+        *success = false;
+        return 0;
+      }
+      return (op == '/' ? (sword_t)val1 / (sword_t)val2 : val1 % val2);
     case TK_EQ: return val1 == val2;
     case TK_NEQ: return val1 != val2;
     case TK_AND: return val1 && val2;
@@ -419,27 +370,9 @@ static word_t calc2(word_t val1, int op, word_t val2, bool *success) {
   return 0;
 }
 
-static int get_op_rank(int op) {
-  for (int i = 0; i < sizeof(op_ranks)/sizeof(op_ranks[0]); i++) {
-    if (op == op_ranks[i].token_type) {
-      return op_ranks[i].rank;
-    }
-  }
-  return 0;
-}
-
-static bool is_unary_operator(int op) {
-  switch (op) {
-    case TK_POSITIVE:
-    case TK_NEGATIVE:
-    case TK_DEREF:
-    case '!':
-    case '~':
-      return true;
-  }
-  return false;
-}
-
+/* Check the expressions generated by tools/gen-expr, then evaluate them
+ * again and again for a second to measure the throughput.
+ */
 void test_expr() {
   const char *nemu_home = getenv("NEMU_HOME");
   if (nemu_home == NULL) {
@@ -451,23 +384,20 @@ void test_expr() {
   snprintf(file_path, sizeof(file_path), "%s/%s", nemu_home, "tools/gen-expr/build/input");
 
   FILE *fp = fopen(file_path, "r");
-  assert(fp != NULL);
+  Assert(fp != NULL, "Can not open '%s', please run `make -C tools/gen-expr input' first", file_path);
 
-  char *e = NULL;
+  char **exprs = NULL;
+  size_t n = 0, max = 0, nr_byte = 0;
   word_t correct_val;
-  size_t len;
-  ssize_t read;
-  bool success = true;
 
-  size_t n = 0;
-
-  while (true) {
-    if(fscanf(fp, "%lu ", &correct_val) == -1) {
-      break;
-    }
-    read = getline(&e, &len, fp);
-    e[read-1] = '\0';
+  while (fscanf(fp, "%lu ", &correct_val) == 1) {
+    char *e = NULL;
+    size_t len = 0;
+    ssize_t read = getline(&e, &len, fp);
+    assert(read > 0);
+    if (e[read - 1] == '\n') e[read - 1] = '\0';
 
+    bool success = true;
     word_t val = expr(e, &success);
 
     assert(success);
@@ -477,12 +407,34 @@ void test_expr() {
       printf("expected: %lu, got: %lu\n", correct_val, val);
       assert(0);
     }
-    n++;
+
+    if (n == max) {
+      max = (max == 0 ? 1024 : max * 2);
+      exprs = realloc(exprs, sizeof(char *) * max);
+      assert(exprs);
+    }
+    exprs[n ++] = e;
+    nr_byte += strlen(e);
   }
 
   fclose(fp);
-  if (e != NULL)
-    free(e);
-
   Log("expr test passed %zu", n);
-} 
\ No newline at end of file
+  if (n == 0) return;
+
+  uint64_t nr_eval = 0, start = get_time(), now;
+  do {
+    for (size_t i = 0; i < n; i ++) {
+      bool success = true;
+      expr(exprs[i], &success);
+    }
+    nr_eval ++;
+  } while ((now = get_time()) - start < 1000000);
+
+  double us = now - start;
+  Log("expr benchmark: %.2f M expressions/s, %.2f MB/s", nr_eval * n / us, nr_eval * nr_byte / us);
+
+  for (size_t i = 0; i < n; i ++) {
+    free(exprs[i]);
+  }
+  free(exprs);
+}
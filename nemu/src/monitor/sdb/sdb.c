@@ -16,6 +16,9 @@
 #include <isa.h>
 #include <cpu/cpu.h>
 #include <cpu/difftest.h>
+#include <cpu/stats.h>
+#include <cpu/breakpoint.h>
+#include <unistd.h>
 #include <readline/readline.h>
 #include <readline/history.h>
 #include "memory/paddr.h"
@@ -23,8 +26,12 @@
 #include "sdb.h"
 
 static int is_batch_mode = false;
+static const char *script_file = NULL;
+// JSON Lines output of the commands, one object for each command
+static FILE *json_out = NULL;
+// the object of the current command, NULL if JSON is not requested
+FILE *json_fp = NULL;
 
-void init_regex();
 void init_wp_pool();
 
 /* We use the `readline' library to provide more flexibility to read from stdin. */
@@ -45,8 +52,55 @@ static char* rl_gets() {
   return line_read;
 }
 
+void json_str(FILE *fp, const char *s) {
+  fputc('"', fp);
+  for (; *s != '\0'; s ++) {
+    switch (*s) {
+      case '"': case '\\': fprintf(fp, "\\%c", *s); break;
+      case '\n': fputs("\\n", fp); break;
+      case '\t': fputs("\\t", fp); break;
+      default:
+        if ((unsigned char)*s < 0x20) fprintf(fp, "\\u%04x", *s);
+        else fputc(*s, fp);
+    }
+  }
+  fputc('"', fp);
+}
+
+/* Run N instructions, but stop at a breakpoint whose condition holds. */
+static void sdb_exec(uint64_t n) {
+  uint64_t start = g_nr_guest_inst;
+  int bp_no = 0;
+  wp_hit_no = -1;
+#ifdef CONFIG_BREAKPOINT
+  while (n > 0) {
+    uint64_t step_start = g_nr_guest_inst;
+    bp_hit = mw_hit = false;
+    cpu_exec(n);
+    n -= g_nr_guest_inst - step_start;
+    // a write to a `*ADDR' watchpoint which does not change the value
+    if (mw_hit && !wp_mem_changed() && nemu_state.state == NEMU_STOP) continue;
+    if (!bp_hit || (bp_no = bp_check_cond()) != 0) break;
+  }
+#else
+  cpu_exec(n);
+#endif
+
+  if (json_fp != NULL) {
+    static const char *state[] = {
+      [NEMU_RUNNING] = "running", [NEMU_STOP] = "stop", [NEMU_END] = "end",
+      [NEMU_ABORT] = "abort", [NEMU_QUIT] = "quit",
+    };
+    fprintf(json_fp, ",\"state\":\"%s\",\"pc\":\"" FMT_WORD "\",\"insts\":%" PRIu64,
+        state[nemu_state.state], cpu.pc, g_nr_guest_inst - start);
+    if (nemu_state.state == NEMU_END) fprintf(json_fp, ",\"halt_ret\":%d", (int)nemu_state.halt_ret);
+    if (bp_no != 0) fprintf(json_fp, ",\"breakpoint\":%d", bp_no);
+    if (wp_hit_no >= 0) fprintf(json_fp, ",\"watchpoint\":%d", wp_hit_no);
+  }
+}
+
 static int cmd_c(char *args) {
-  cpu_exec(-1);
+  sdb_exec(-1);
   return 0;
 }
 
@@ -70,6 +124,12 @@ static int cmd_w(char *args);
 
 static int cmd_d(char *args);
 
+#ifdef CONFIG_BREAKPOINT
+static int cmd_b(char *args);
+
+static int cmd_bd(char *args);
+#endif
+
 #ifdef CONFIG_DIFFTEST
 static int cmd_detach(char *args);
 
@@ -91,11 +151,15 @@ static struct {
 
   /* TODO: Add more commands */
   {"si", "Execute next [N] instruction (after stopping)", cmd_si },
-  {"info", "Display information about registers or watchpoints", cmd_info },
+  {"info", "Display information about registers, watchpoints or statistics", cmd_info },
   {"x", "Dispaly [N] bytes of memory, starting at address [EXPR]", cmd_x },
   {"p", "Calculate the value of [EXPR]", cmd_p },
-  {"w", "Set watchpoint at the memory address of [EXPR]", cmd_w},
+  {"w", "Set watchpoint on [EXPR], stop when its value changes", cmd_w},
   {"d", "Delete [No] watchpoint in the memory", cmd_d},
+#ifdef CONFIG_BREAKPOINT
+  {"b", "Set breakpoint at [FUNC], [ADDR] or [*ADDR], stop only if [EXPR] holds with `if [EXPR]'", cmd_b},
+  {"bd", "Delete [No] breakpoint", cmd_bd},
+#endif
 #ifdef CONFIG_DIFFTEST
   {"detach", "Disable difftest", cmd_detach},
   {"attach", "Enable difftest", cmd_attach},
@@ -138,12 +202,23 @@ static int cmd_si(char *args) {
     /* argument is illegal */
     printf("(nemu) Usage: si [N]\n");
   } else {
-    cpu_exec(n);
+    sdb_exec(n);
   }
 
   return 0;
 }
 
+static void reg_display_json() {
+  extern const char* regs[];
+  fprintf(json_fp, ",\"regs\":{\"pc\":\"" FMT_WORD "\"", cpu.pc);
+  for (int i = 0; i < ARRLEN(cpu.gpr); i ++) {
+    fputc(',', json_fp);
+    json_str(json_fp, regs[i]);
+    fprintf(json_fp, ":\"" FMT_WORD "\"", cpu.gpr[i]);
+  }
+  fputc('}', json_fp);
+}
+
 static int cmd_info(char *args) {
   /* extract the first argument */
   char *arg = strtok(NULL, " ");
@@ -151,22 +226,39 @@ static int cmd_info(char *args) {
 
   /* argument is illegal */
   if (arg == NULL || sscanf(arg, "%c", &ch) != 1 || (arg = strtok(NULL, " ")) != NULL) {
-    printf("(nemu) Usage: info [r or w]\n");
+    printf("(nemu) Usage: info [r, w, b or stats]\n");
     return 0;
   }
 
   switch (ch) {
     case 'r':
       /* display information about registers */
-      isa_reg_display();
+      if (json_fp != NULL) reg_display_json();
+      else isa_reg_display();
       break;
     case 'w':
       /* display information about watchpoints */
-      wp_display();
+      if (json_fp != NULL) wp_display_json(json_fp);
+      else wp_display();
+      break;
+#ifdef CONFIG_BREAKPOINT
+    case 'b':
+      /* display information about breakpoints */
+      if (json_fp != NULL) bp_display_json(json_fp);
+      else bp_display();
       break;
+#endif
+#ifdef CONFIG_STATS
+    case 's':
+      /* display the instruction mix */
+      if (json_fp != NULL) stats_json(json_fp);
+      else stats_display();
+      break;
+#endif
     default:
       /* argument is illegal */
-      printf("(nemu) Usage: info [r or w]\n");
+      printf("(nemu) Usage: info [r, w, b or stats]\n");
+      if (json_fp != NULL) fputs(",\"error\":\"usage\"", json_fp);
       break;
   }
   return 0;
@@ -179,24 +271,28 @@ static int cmd_x(char *args) {
   bool success = true;
 
   /* extract the first argument */
-  if (arg == NULL || sscanf(arg, "%d", &n) != 1) {
+  if (arg == NULL || sscanf(arg, "%d", &n) != 1 || (arg = strtok(NULL, "")) == NULL) {
     printf("(nemu) Usage: x [N] [EXPR]\n");
     return 0;
   } 
 
-  arg = arg + strlen(arg) + 1;
   /* calculate expression to find address */
   addr = expr(arg, &success);
   if(success != true) {
     printf("EXPR error!\n");
     printf("(nemu) Usage: x [N] [EXPR]\n");
+    if (json_fp != NULL) fprintf(json_fp, ",\"error\":\"EXPR error\"");
     return 0;
   }
 
+  if (json_fp != NULL) fprintf(json_fp, ",\"addr\":\"0x%08lx\",\"words\":[", addr);
   for (int i = 0; i < n; i++) {
-    printf("0x%08lx: 0x%08lx\n", addr, vaddr_read(addr, 4)); 
+    word_t data = vaddr_read(addr, 4);
+    if (json_fp != NULL) fprintf(json_fp, "%s\"0x%08lx\"", (i == 0 ? "" : ","), data);
+    else printf("0x%08lx: 0x%08lx\n", addr, data);
     addr += 4;
   }
+  if (json_fp != NULL) fputc(']', json_fp);
 
   return 0;
 }
@@ -204,11 +300,13 @@ static int cmd_x(char *args) {
 static int cmd_p(char *args) {
   bool success = true;
 
-  word_t  value = expr(args, &success);
+  word_t  value = (args != NULL ? expr(args, &success) : 0);
 
-  if (success == true) {
-    printf("0x%016lx\n", value);
+  if (args != NULL && success == true) {
+    if (json_fp != NULL) fprintf(json_fp, ",\"value\":\"0x%016lx\"", value);
+    else printf("0x%016lx\n", value);
   } else {
+    if (json_fp != NULL) fprintf(json_fp, ",\"error\":\"EXPR error\"");
     printf("EXPR error!\n");
     printf("(nemu) Usage: p [EXPR]\n");
   }
@@ -217,23 +315,39 @@ static int cmd_p(char *args) {
 }
 
 static int cmd_w(char *args) {
-  /* extract the first argument */
-  char *arg = strtok(NULL, " ");
   bool success = true;
 
-  if (arg == NULL) {
+  if (args == NULL) {
     printf("(nemu) Usage: w [EXPR]\n");
+    return 0;
   }
 
-  word_t old = expr(args, &success);
+  WP *p = new_wp();
+  if (!expr_compile(args, &p->code)) {
+    free_wp(p);
+    printf("EXPR error!\n");
+    printf("(nemu) Usage: w [EXPR]\n");
+    return 0;
+  }
+
+  word_t old = expr_run(&p->code, &success);
   if (success != true) {
+    free_wp(p);
     printf("EXPR error!\n");
-    printf("(nemu) Usage: p [EXPR]\n");
+    printf("(nemu) Usage: w [EXPR]\n");
   } else {
-    WP *p = new_wp();
     strncpy(p->buf, args, sizeof(p->buf) - 1);
     p->old = old;
+#ifdef CONFIG_BREAKPOINT
+    // `*ADDR' is checked on the writes to ADDR instead of after every instruction
+    if (expr_mem_addr(&p->code, &p->addr) && in_pmem(p->addr) &&
+        p->addr <= CONFIG_MBASE + CONFIG_MSIZE - 8 && mw_insert(p->addr, 8, MW_WRITE)) {
+      p->mem = true;
+      p->old = paddr_read(p->addr, 8);
+    }
+#endif
     printf("Watchpoint %d: %s\n", p->NO, args);
+    if (json_fp != NULL) fprintf(json_fp, ",\"watchpoint\":%d", p->NO);
   }
   return 0;
 }
@@ -257,6 +371,40 @@ static int cmd_d(char *args) {
   return 0;
 }
 
+#ifdef CONFIG_BREAKPOINT
+static int cmd_b(char *args) {
+  /* extract the location and the optional `if EXPR' */
+  char *loc = strtok(NULL, " ");
+  char *cond = strtok(NULL, "");
+
+  if (loc == NULL || (cond != NULL && strncmp(cond, "if ", 3) != 0)) {
+    printf("(nemu) Usage: b [FUNC|ADDR|*ADDR] [if EXPR]\n");
+    return 0;
+  }
+
+  int no = bp_add(loc, (cond != NULL ? cond + 3 : NULL));
+  if (json_fp != NULL && no > 0) fprintf(json_fp, ",\"breakpoint\":%d", no);
+  return 0;
+}
+
+static int cmd_bd(char *args) {
+  /* extract the first argument */
+  char *arg = strtok(NULL, " ");
+  int no = 0;
+
+  if (arg == NULL || sscanf(arg, "%d", &no) != 1 || (arg = strtok(NULL, " ")) != NULL) {
+    /* argument is illegal */
+    printf("(nemu) Usage: bd [No]\n");
+  } else if (bp_delete(no)) {
+    printf("Delete breakpoint %d\n", no);
+  } else {
+    printf("No breakpoint %d\n", no);
+  }
+
+  return 0;
+}
+#endif
+
 #ifdef CONFIG_DIFFTEST
 static int cmd_detach(char *args) {
   printf("Disable difftest!\n");
@@ -308,50 +456,127 @@ void sdb_set_batch_mode() {
   is_batch_mode = true;
 }
 
-void sdb_mainloop() {
-  if (is_batch_mode) {
-    cmd_c(NULL);
+void sdb_set_script(const char *file) {
+  script_file = file;
+}
+
+void sdb_set_json(const char *file) {
+  if (file != NULL) {
+    json_out = fopen(file, "w");
+    Assert(json_out, "Can not open '%s'", file);
     return;
   }
+  // keep stdout for the JSON lines only, and send everything else
+  // printed by NEMU and the guest to stderr
+  fflush(stdout);
+  int fd = dup(STDOUT_FILENO);
+  Assert(fd >= 0 && dup2(STDERR_FILENO, STDOUT_FILENO) >= 0, "Can not redirect stdout");
+  json_out = fdopen(fd, "w");
+  assert(json_out);
+}
 
-  for (char *str; (str = rl_gets()) != NULL; ) {
-    char *str_end = str + strlen(str);
-
-    /* extract the first token as the command */
-    char *cmd = strtok(str, " ");
-    if (cmd == NULL) { continue; }
-
-    /* treat the remaining string as the arguments,
-     * which may need further parsing
-     */
-    char *args = cmd + strlen(cmd) + 1;
-    if (args >= str_end) {
-      args = NULL;
-    }
+/* Execute one command line, return -1 when sdb should quit. */
+static int sdb_exec_line(char *str) {
+  char *str_end = str + strlen(str);
+
+  /* extract the first token as the command */
+  char *cmd = strtok(str, " ");
+  if (cmd == NULL) { return 0; }
+
+  /* the object is built in memory, so that it is not broken by the
+   * text output of the command */
+  char *json_buf = NULL;
+  size_t json_size = 0;
+  if (json_out != NULL) {
+    json_fp = open_memstream(&json_buf, &json_size);
+    assert(json_fp);
+    /* the arguments are cut by strtok() later */
+    fputs("{\"cmd\":", json_fp);
+    json_str(json_fp, cmd);
+    fputs(",\"args\":", json_fp);
+    json_str(json_fp, (cmd + strlen(cmd) < str_end ? cmd + strlen(cmd) + 1 : ""));
+  }
+
+  /* treat the remaining string as the arguments,
+   * which may need further parsing
+   */
+  char *args = cmd + strlen(cmd) + 1;
+  if (args >= str_end) {
+    args = NULL;
+  }
 
 #ifdef CONFIG_DEVICE
-    extern void sdl_clear_event_queue();
-    sdl_clear_event_queue();
+  extern void sdl_clear_event_queue();
+  sdl_clear_event_queue();
 #endif
 
-    int i;
-    for (i = 0; i < NR_CMD; i ++) {
-      if (strcmp(cmd, cmd_table[i].name) == 0) {
-        if (cmd_table[i].handler(args) < 0) { return; }
-        break;
-      }
+  int i, ret = 0;
+  for (i = 0; i < NR_CMD; i ++) {
+    if (strcmp(cmd, cmd_table[i].name) == 0) {
+      ret = cmd_table[i].handler(args);
+      break;
     }
+  }
 
-    if (i == NR_CMD) { printf("Unknown command '%s'\n", cmd); }
+  if (i == NR_CMD) {
+    printf("Unknown command '%s'\n", cmd);
+    if (json_fp != NULL) fputs(",\"error\":\"unknown command\"", json_fp);
   }
+  if (json_fp != NULL) {
+    fputs("}\n", json_fp);
+    fclose(json_fp);
+    json_fp = NULL;
+    fputs(json_buf, json_out);
+    fflush(json_out);
+    free(json_buf);
+  }
+  return ret;
 }
 
-void init_sdb() {
-  /* Compile the regular expressions. */
-  init_regex();
+/* Run the commands in the script file without readline. Empty lines and
+ * lines beginning with `#' are skipped. The end of the script works as `q'
+ * unless the program has ended.
+ */
+static void sdb_run_script() {
+  FILE *fp = fopen(script_file, "r");
+  Assert(fp, "Can not open '%s'", script_file);
+
+  char *line = NULL;
+  size_t len = 0;
+  ssize_t n;
+  while ((n = getline(&line, &len, fp)) != -1) {
+    while (n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r')) line[-- n] = '\0';
+    char *p = line + strspn(line, " \t");
+    if (*p == '\0' || *p == '#') continue;
+    printf("(nemu) %s\n", p);
+    if (sdb_exec_line(p) < 0) break;
+  }
+  free(line);
+  fclose(fp);
+
+  if (nemu_state.state == NEMU_STOP) nemu_state.state = NEMU_QUIT;
+}
+
+void sdb_mainloop() {
+  if (script_file != NULL) {
+    sdb_run_script();
+    return;
+  }
+
+  if (is_batch_mode) {
+    char cmd[] = "c";
+    sdb_exec_line(cmd);
+    return;
+  }
 
+  for (char *str; (str = rl_gets()) != NULL; ) {
+    if (sdb_exec_line(str) < 0) { return; }
+  }
+}
+
+void init_sdb() {
   /* test math expression calcuation */
-  // test_expr();
+  IFDEF(CONFIG_EXPR_TEST, test_expr());
 
   /* Initialize the watchpoint pool. */
   init_wp_pool();
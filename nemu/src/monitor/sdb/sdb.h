@@ -18,6 +18,20 @@
 
 #include <common.h>
 
+/* An expression compiled into postfix order, so that it can be evaluated
+ * with a small stack instead of being lexed and parsed again. */
+typedef struct {
+  int op;        // token type
+  word_t val;    // value of a number
+  char reg[8];   // name of a register
+} ExprInst;
+
+typedef struct {
+  int n, max;
+  int sp, depth; // the stack used by the code
+  ExprInst *inst;
+} ExprCode;
+
 typedef struct watchpoint {
   int NO;
   struct watchpoint *next;
@@ -25,14 +39,44 @@ typedef struct watchpoint {
   /* TODO: Add more members if necessary */
   char buf[128];
   word_t old;
+  ExprCode code;
+  // `*ADDR' with a constant ADDR is only checked when ADDR is written
+  bool mem;
+  vaddr_t addr;
 } WP;
 
+typedef struct breakpoint {
+  int NO;
+  struct breakpoint *next;
+
+  vaddr_t pc;
+  uint64_t hits;
+  char cond_buf[128];  // empty when there is no condition
+  ExprCode cond;
+} BP;
+
 word_t expr(char *e, bool *success);
+bool expr_compile(char *e, ExprCode *code);
+word_t expr_run(const ExprCode *code, bool *success);
+void expr_free(ExprCode *code);
+bool expr_mem_addr(const ExprCode *code, vaddr_t *addr);
 void test_expr();
 
+extern FILE *json_fp;
+void json_str(FILE *fp, const char *s);
+
+extern int wp_hit_no;
 void wp_difftest();
+bool wp_mem_changed();
 WP* new_wp();
 void free_wp(WP *wp);
 WP* find_wp(int no);
 void wp_display();
+void wp_display_json(FILE *fp);
+
+int bp_add(char *loc, char *cond);
+bool bp_delete(int no);
+int bp_check_cond();
+void bp_display();
+void bp_display_json(FILE *fp);
 #endif
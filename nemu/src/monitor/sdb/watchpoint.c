@@ -13,15 +13,23 @@
 * See the Mulan PSL v2 for more details.
 ***************************************************************************************/
 
+#include <machine.h>
+#include <memory/paddr.h>
+#include <cpu/breakpoint.h>
 #include "sdb.h"
 
 #define NR_WP 32
 
-static WP wp_pool[NR_WP] = {};
-static WP *head = NULL, *free_ = NULL;
+#define wp_pool (g_machine->wp_pool)
+#define head    (g_machine->wp_head)
+#define free_   (g_machine->wp_free)
 
 void init_wp_pool() {
   int i;
+  if (wp_pool == NULL) {
+    wp_pool = malloc(sizeof(WP) * NR_WP);
+    assert(wp_pool);
+  }
   for (i = 0; i < NR_WP; i ++) {
     wp_pool[i].NO = i;
     wp_pool[i].next = (i == NR_WP - 1 ? NULL : &wp_pool[i + 1]);
@@ -31,26 +39,76 @@ void init_wp_pool() {
   free_ = wp_pool;
 }
 
+// the last watchpoint whose value changed
+int wp_hit_no = -1;
+
+// compare the value of `p' with the old one, and report the change
+static bool wp_update(WP *p) {
+  word_t new;
+  if (p->mem) new = paddr_read(p->addr, 8);
+  else {
+    bool success = true;
+    new = expr_run(&p->code, &success);
+  }
+  bool changed = (p->old != new);
+  if (changed) {
+    printf("Watchpoints %d: %s\n", p->NO, p->buf);
+    printf("Old value: %lu\n", p->old);
+    printf("New value: %lu\n", new);
+    wp_hit_no = p->NO;
+  }
+  p->old = new;
+  return changed;
+}
+
 /* TODO: Implement the functionality of watchpoint */
 void wp_difftest() {
+  bool changed = false;
+  IFDEF(CONFIG_BREAKPOINT, bool has_mem = false);
   for (WP *p = head; p != NULL; p = p->next) {
-    bool success = true;
-    word_t new = expr(p->buf, &success);
-    if (p->old != new) {
-      printf("Watchpoints %d: %s\n", p->NO, p->buf);
-      printf("Old value: %lu\n", p->old);
-      printf("New value: %lu\n", new);
+#ifdef CONFIG_BREAKPOINT
+    if (p->mem) {
+      // only a write to the watched memory can change the value
+      has_mem = true;
+      if (!mw_hit) continue;
     }
-    p->old = new;
+#endif
+    changed |= wp_update(p);
+  }
+
+#ifdef CONFIG_BREAKPOINT
+  if (has_mem && mw_hit) {
+    // the write does not change the value, keep running
+    mw_hit = false;
+    if (!changed && nemu_state.state == NEMU_STOP) nemu_state.state = NEMU_RUNNING;
   }
+#endif
+  if (changed && nemu_state.state == NEMU_RUNNING) nemu_state.state = NEMU_STOP;
 }
 
+#ifdef CONFIG_BREAKPOINT
+/* Check the `*ADDR' watchpoints after cpu_exec() stops at a write to
+ * them. This is how they work without CONFIG_WATCHPOINT, which checks
+ * them in wp_difftest() after every instruction instead.
+ */
+bool wp_mem_changed() {
+  bool changed = false;
+  for (WP *p = head; p != NULL; p = p->next) {
+    if (p->mem) changed |= wp_update(p);
+  }
+  mw_hit = false;
+  return changed;
+}
+#endif
+
 WP* new_wp() {
   if (free_ != NULL) {
     WP* tmp = free_;
     free_ = free_->next;
 
+    int no = tmp->NO;
     memset(tmp, 0, sizeof(WP));
+    tmp->NO = no;
     tmp->next = head;
     head = tmp;
     return tmp;
@@ -62,6 +120,9 @@ WP* new_wp() {
 
 void free_wp(WP *wp) {
   WP *pre = NULL, *curr = head;
+
+  IFDEF(CONFIG_BREAKPOINT, if (wp->mem) mw_remove(wp->addr, 8, MW_WRITE));
+  expr_free(&wp->code);
   
   for (; curr != NULL; pre = curr, curr = curr->next) {
     if (curr == wp) {
@@ -102,3 +163,13 @@ void wp_display() {
     }
   }
 }
+
+void wp_display_json(FILE *fp) {
+  fputs(",\"watchpoints\":[", fp);
+  for (WP *p = head; p != NULL; p = p->next) {
+    fprintf(fp, "%s{\"no\":%d,\"expr\":", (p == head ? "" : ","), p->NO);
+    json_str(fp, p->buf);
+    fprintf(fp, ",\"value\":\"0x%016lx\"}", p->old);
+  }
+  fputc(']', fp);
+}
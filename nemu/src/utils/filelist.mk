@@ -18,3 +18,5 @@ CXXSRC = src/utils/disasm.cc
 CXXFLAGS += $(shell llvm-config --cxxflags) -fPIE
 LIBS += $(shell llvm-config --libs)
 endif
+
+LIBS += $(if $(CONFIG_ASYNC_LOG),-lpthread,)
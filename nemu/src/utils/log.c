@@ -13,19 +13,171 @@
 * See the Mulan PSL v2 for more details.
 ***************************************************************************************/
 
-#include <common.h>
-
-extern uint64_t g_nr_guest_inst;
+#include <machine.h>
 
 #ifndef CONFIG_TARGET_AM
 FILE *log_fp = NULL;
 
+#ifdef CONFIG_ASYNC_LOG
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <unistd.h>
+
+/* A bounded multi-producer ring of log records, drained into log_fp by a
+ * writer thread. A record takes one or more consecutive slots, which a
+ * producer claims at once by moving `head' with a CAS. The sequence number
+ * of a slot tells its state: it equals the position when the slot is free,
+ * and the position plus one when the record starting there is published.
+ * The writer consumes records in order, so the last slot of a claim being
+ * free means the whole claim is free.
+ */
+#define NR_SLOT CONFIG_ASYNC_LOG_SLOTS
+#define SLOT_SIZE 128
+#define RECORD_MAX 4096  // longer records are truncated
+#define IDLE_US 200      // the writer (or a blocked producer) sleeps this long
+
+typedef struct {
+  uint64_t seq;
+  uint32_t len;  // length of the record, only valid in its first slot
+  char data[SLOT_SIZE - 12];
+} Slot;
+
+#define DATA_SIZE sizeof(((Slot *)0)->data)
+
+static_assert((NR_SLOT & (NR_SLOT - 1)) == 0, "ASYNC_LOG_SLOTS should be a power of 2");
+static_assert((RECORD_MAX + DATA_SIZE - 1) / DATA_SIZE <= NR_SLOT, "ASYNC_LOG_SLOTS is too small");
+
+static Slot *ring = NULL;
+static uint64_t head = 0, tail = 0;
+static uint64_t dropped = 0;
+static bool stopping = false;
+static pthread_t writer_tid;
+
+void log_async(const char *fmt, ...) {
+  char buf[RECORD_MAX];
+  va_list ap;
+  va_start(ap, fmt);
+  int len = vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+  if (len <= 0) return;
+  if (len >= sizeof(buf)) len = sizeof(buf) - 1;
+
+  if (ring == NULL) {
+    fwrite(buf, 1, len, log_fp);
+    fflush(log_fp);
+    return;
+  }
+
+  uint64_t k = (len + DATA_SIZE - 1) / DATA_SIZE;
+  uint64_t pos = __atomic_load_n(&head, __ATOMIC_RELAXED);
+  while (true) {
+    uint64_t seq = __atomic_load_n(&ring[(pos + k - 1) % NR_SLOT].seq, __ATOMIC_ACQUIRE);
+    if (seq == pos + k - 1) {
+      if (__atomic_compare_exchange_n(&head, &pos, pos + k, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+      continue;  // pos is reloaded by the failed CAS
+    }
+    if (seq < pos + k - 1) {
+      // the ring is full
+      if (MUXDEF(CONFIG_ASYNC_LOG_DROP, true, false)) {
+        __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+        return;
+      }
+      usleep(IDLE_US);
+    }
+    pos = __atomic_load_n(&head, __ATOMIC_RELAXED);
+  }
+
+  for (uint64_t i = 0; i < k; i ++) {
+    Slot *s = &ring[(pos + i) % NR_SLOT];
+    int n = (len - i * DATA_SIZE < DATA_SIZE ? len - i * DATA_SIZE : DATA_SIZE);
+    memcpy(s->data, buf + i * DATA_SIZE, n);
+    if (i != 0) __atomic_store_n(&s->seq, pos + i + 1, __ATOMIC_RELAXED);
+  }
+  ring[pos % NR_SLOT].len = len;
+  // publishing the first slot makes the whole record visible to the writer
+  __atomic_store_n(&ring[pos % NR_SLOT].seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+// only called by one thread at a time, return whether anything is written
+static bool drain() {
+  bool busy = false;
+  while (true) {
+    Slot *first = &ring[tail % NR_SLOT];
+    if (__atomic_load_n(&first->seq, __ATOMIC_ACQUIRE) != tail + 1) break;
+    uint32_t len = first->len;
+    uint64_t k = (len + DATA_SIZE - 1) / DATA_SIZE;
+    for (uint64_t i = 0; i < k; i ++) {
+      Slot *s = &ring[(tail + i) % NR_SLOT];
+      fwrite(s->data, 1, (len - i * DATA_SIZE < DATA_SIZE ? len - i * DATA_SIZE : DATA_SIZE), log_fp);
+      __atomic_store_n(&s->seq, tail + i + NR_SLOT, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&tail, tail + k, __ATOMIC_RELEASE);
+    busy = true;
+  }
+  if (busy) fflush(log_fp);
+  return busy;
+}
+
+static void *writer(void *arg) {
+  while (true) {
+    if (drain()) continue;
+    if (__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) return NULL;
+    usleep(IDLE_US);
+  }
+}
+
+static void stop_writer() {
+  __atomic_store_n(&stopping, true, __ATOMIC_RELEASE);
+  pthread_join(writer_tid, NULL);
+  drain();
+  ring = NULL;
+  if (dropped != 0) {
+    fprintf(log_fp, "%" PRIu64 " log records are dropped since the log ring is full\n", dropped);
+  }
+  fflush(log_fp);
+}
+
+void log_flush();
+
+// the records of a failed assert() should reach the file, too
+static void abort_handler(int sig) {
+  log_flush();
+}
+
+static void start_writer() {
+  ring = calloc(NR_SLOT, sizeof(Slot));
+  assert(ring);
+  for (int i = 0; i < NR_SLOT; i ++) ring[i].seq = i;
+  int ret = pthread_create(&writer_tid, NULL, writer, NULL);
+  assert(ret == 0);
+  atexit(stop_writer);
+  signal(SIGABRT, abort_handler);
+}
+#endif
+
+// wait for the records in the log ring to reach the file, e.g. before abort
+void log_flush() {
+#ifdef CONFIG_ASYNC_LOG
+  if (ring != NULL) {
+    uint64_t target = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+    // a producer interrupted before publishing its record should not hang us
+    for (int i = 0; i < 1000000 / IDLE_US && __atomic_load_n(&tail, __ATOMIC_ACQUIRE) < target; i ++) {
+      usleep(IDLE_US);
+    }
+  }
+#endif
+  fflush(log_fp);
+}
+
 void init_log(const char *log_file) {
   log_fp = stdout;
   if (log_file != NULL) {
     FILE *fp = fopen(log_file, "w");
     Assert(fp, "Can not open '%s'", log_file);
     log_fp = fp;
+    // the log on stdout is kept synchronous, since it is interleaved with other output
+    IFDEF(CONFIG_ASYNC_LOG, start_writer());
   }
   Log("Log is written to %s", log_file ? log_file : "stdout");
 }
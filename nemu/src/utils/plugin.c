@@ -0,0 +1,100 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <plugin.h>
+#include <nemu-plugin.h>
+#include <memory/paddr.h>
+#include <memory/host.h>
+#include <dlfcn.h>
+
+#ifdef CONFIG_PLUGIN
+PluginEvent plugin_events[NR_PLUGIN_EVENT] = {};
+
+static void subscribe(int ev, void *cb, void *udata) {
+  PluginEvent *e = &plugin_events[ev];
+  Assert(e->nr < MAX_PLUGIN_CB, "too many plugin callbacks");
+  e->cb[e->nr].cb = cb;
+  e->cb[e->nr].udata = udata;
+  e->nr ++;
+}
+
+static void register_insn_cb(nemu_insn_cb_t cb, void *udata) { subscribe(PLUGIN_INSN, cb, udata); }
+static void register_block_cb(nemu_block_cb_t cb, void *udata) { subscribe(PLUGIN_BLOCK, cb, udata); }
+static void register_mem_cb(nemu_mem_cb_t cb, void *udata) { subscribe(PLUGIN_MEM, cb, udata); }
+static void register_trap_cb(nemu_trap_cb_t cb, void *udata) { subscribe(PLUGIN_TRAP, cb, udata); }
+static void register_exit_cb(nemu_exit_cb_t cb, void *udata) { subscribe(PLUGIN_EXIT, cb, udata); }
+
+static uint64_t read_reg(int idx) {
+  return (idx >= 0 && idx < ARRLEN(cpu.gpr) ? cpu.gpr[idx] : 0);
+}
+
+static uint64_t read_pc() { return cpu.pc; }
+
+// read pmem without the side effects of a guest access, 0 for other addresses
+static uint64_t read_mem(uint64_t addr, int len) {
+  if (len != 1 && len != 2 && len != 4 && len != 8) return 0;
+  if (addr < CONFIG_MBASE || addr > CONFIG_MBASE + CONFIG_MSIZE - len) return 0;
+  return host_read(guest_to_host(addr), len);
+}
+
+static uint64_t nr_guest_inst() { return g_nr_guest_inst; }
+
+static const nemu_plugin_api api = {
+  .version = NEMU_PLUGIN_VERSION,
+  .isa = str(__GUEST_ISA__),
+  .register_insn_cb = register_insn_cb,
+  .register_block_cb = register_block_cb,
+  .register_mem_cb = register_mem_cb,
+  .register_trap_cb = register_trap_cb,
+  .register_exit_cb = register_exit_cb,
+  .read_reg = read_reg,
+  .read_pc = read_pc,
+  .read_mem = read_mem,
+  .nr_guest_inst = nr_guest_inst,
+};
+
+// spec is "FILE.so[,ARGS]"
+void init_plugin(const char *spec) {
+  char file[256];
+  const char *args = strchr(spec, ',');
+  int len = (args == NULL ? strlen(spec) : args - spec);
+  Assert(len < sizeof(file), "plugin file name is too long");
+  memcpy(file, spec, len);
+  file[len] = '\0';
+  args = (args == NULL ? "" : args + 1);
+
+  void *handle = dlopen(file, RTLD_NOW | RTLD_LOCAL);
+  Assert(handle, "%s", dlerror());
+  int (*install)(const nemu_plugin_api *, const char *) = dlsym(handle, "nemu_plugin_install");
+  Assert(install, "%s does not define nemu_plugin_install()", file);
+  int ret = install(&api, args);
+  Assert(ret == 0, "failed to install plugin %s, ret = %d", file, ret);
+  Log("Plugin %s is installed", file);
+}
+
+#define FOREACH_CB(ev, type, ...) do { \
+  PluginEvent *e = &plugin_events[ev]; \
+  for (int i = 0; i < e->nr; i ++) ((type)e->cb[i].cb)(e->cb[i].udata, ## __VA_ARGS__); \
+} while (0)
+
+void plugin_insn(vaddr_t pc, uint32_t inst) { FOREACH_CB(PLUGIN_INSN, nemu_insn_cb_t, pc, inst); }
+void plugin_block(vaddr_t pc) { FOREACH_CB(PLUGIN_BLOCK, nemu_block_cb_t, pc); }
+void plugin_mem(vaddr_t addr, int len, bool is_write, word_t data) {
+  FOREACH_CB(PLUGIN_MEM, nemu_mem_cb_t, addr, len, is_write, data);
+}
+void plugin_trap(word_t cause, vaddr_t epc) { FOREACH_CB(PLUGIN_TRAP, nemu_trap_cb_t, cause, epc); }
+void plugin_exit() { FOREACH_CB(PLUGIN_EXIT, nemu_exit_cb_t); }
+#endif
@@ -0,0 +1,270 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+/* Run many independent NEMU jobs in parallel and collect a JSON report.
+ *
+ * Every non-empty line of the job file is
+ *     NAME COMMAND...
+ * where COMMAND is handed to /bin/sh, e.g.
+ *     add  build/riscv64-nemu-interpreter -b ../am-kernels/tests/cpu-tests/build/add-riscv64-nemu.bin
+ * Lines starting with '#' are ignored. The output of each job is kept in
+ * LOGDIR/NAME.log, and the statistics printed by NEMU at exit are scraped
+ * from there.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+typedef struct {
+  char *name;
+  char *cmd;
+  int exit_code;
+  const char *result;
+  uint64_t nr_inst;
+  uint64_t host_us;  // host time reported by NEMU itself
+  uint64_t wall_us;  // wall time of the whole process, including loading
+} Job;
+
+static Job *jobs = NULL;
+static int nr_job = 0;
+static int next_job = 0;  // shared queue head, advanced atomically by the workers
+static const char *log_dir = "build/farm-log";
+
+static uint64_t now_us() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000ull + tv.tv_usec;
+}
+
+static void load_jobs(const char *file) {
+  FILE *fp = fopen(file, "r");
+  if (fp == NULL) { perror(file); exit(1); }
+
+  int cap = 64;
+  jobs = malloc(sizeof(Job) * cap);
+  char *line = NULL;
+  size_t len = 0;
+  while (getline(&line, &len, fp) != -1) {
+    line[strcspn(line, "\r\n")] = '\0';
+    char *name = line + strspn(line, " \t");
+    if (*name == '\0' || *name == '#') continue;
+    char *cmd = name + strcspn(name, " \t");
+    if (*cmd == '\0') {
+      fprintf(stderr, "job '%s' has no command\n", name);
+      exit(1);
+    }
+    *cmd ++ = '\0';
+    cmd += strspn(cmd, " \t");
+    if (strchr(name, '/') != NULL) {
+      // the name is used as the file name of the log
+      fprintf(stderr, "job '%s' has '/' in its name\n", name);
+      exit(1);
+    }
+
+    if (nr_job == cap) {
+      cap *= 2;
+      jobs = realloc(jobs, sizeof(Job) * cap);
+    }
+    jobs[nr_job ++] = (Job) { .name = strdup(name), .cmd = strdup(cmd), .result = "UNKNOWN" };
+  }
+  free(line);
+  fclose(fp);
+}
+
+// like `mkdir -p', return 0 on success
+static int mkdir_p(const char *dir) {
+  char path[512];
+  if (snprintf(path, sizeof(path), "%s", dir) >= sizeof(path)) { errno = ENAMETOOLONG; return -1; }
+  for (char *p = path + 1; ; p ++) {
+    if (*p != '/' && *p != '\0') continue;
+    char c = *p;
+    *p = '\0';
+    if (mkdir(path, 0755) != 0 && errno != EEXIST) return -1;
+    if (c == '\0') break;
+    *p = c;
+  }
+  struct stat st;
+  if (stat(path, &st) != 0) return -1;
+  if (!S_ISDIR(st.st_mode)) { errno = ENOTDIR; return -1; }
+  return 0;
+}
+
+static uint64_t scrape(const char *line, const char *key) {
+  const char *p = strstr(line, key);
+  return p ? strtoull(p + strlen(key), NULL, 10) : 0;
+}
+
+/* pick up the numbers printed by statistic() and the final trap message */
+static void parse_log(Job *j, const char *path) {
+  FILE *fp = fopen(path, "r");
+  if (fp == NULL) return;
+  char *line = NULL;
+  size_t len = 0;
+  while (getline(&line, &len, fp) != -1) {
+    if (strstr(line, "HIT GOOD TRAP")) j->result = "GOOD";
+    else if (strstr(line, "HIT BAD TRAP")) j->result = "BAD";
+    else if (strstr(line, "ABORT")) j->result = "ABORT";
+    if (j->nr_inst == 0) j->nr_inst = scrape(line, "total guest instructions = ");
+    if (j->host_us == 0) j->host_us = scrape(line, "host time spent = ");
+  }
+  free(line);
+  fclose(fp);
+}
+
+static void run_job(Job *j) {
+  char path[512];
+  snprintf(path, sizeof(path), "%s/%s.log", log_dir, j->name);
+
+  posix_spawn_file_actions_t fa;
+  posix_spawn_file_actions_init(&fa);
+  posix_spawn_file_actions_addopen(&fa, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+  posix_spawn_file_actions_addopen(&fa, STDOUT_FILENO, path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  posix_spawn_file_actions_adddup2(&fa, STDOUT_FILENO, STDERR_FILENO);
+
+  char *argv[] = { "/bin/sh", "-c", j->cmd, NULL };
+  uint64_t start = now_us();
+  pid_t pid;
+  int ret = posix_spawn(&pid, argv[0], &fa, NULL, argv, environ);
+  posix_spawn_file_actions_destroy(&fa);
+  if (ret != 0) {
+    j->exit_code = -1;
+    j->result = "SPAWN_FAIL";
+    return;
+  }
+
+  int status;
+  while ((ret = waitpid(pid, &status, 0)) == -1 && errno == EINTR) ;
+  if (ret == -1) {
+    j->exit_code = -1;
+    j->result = "WAIT_FAIL";
+    return;
+  }
+  j->wall_us = now_us() - start;
+  j->exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+  parse_log(j, path);
+}
+
+/* Jobs are independent and coarse-grained, so a single shared queue head
+ * already gives every idle worker the next pending job, which is all that
+ * work stealing would buy us here.
+ */
+static void *worker(void *arg) {
+  while (true) {
+    int i = __atomic_fetch_add(&next_job, 1, __ATOMIC_RELAXED);
+    if (i >= nr_job) break;
+    run_job(&jobs[i]);
+    fprintf(stderr, "[%3d/%d] %-24s %s (exit %d, %.2fs)\n", i + 1, nr_job,
+        jobs[i].name, jobs[i].result, jobs[i].exit_code, jobs[i].wall_us / 1e6);
+  }
+  return NULL;
+}
+
+static void json_str(FILE *fp, const char *s) {
+  fputc('"', fp);
+  for (; *s; s ++) {
+    if (*s == '"' || *s == '\\') fprintf(fp, "\\%c", *s);
+    else if ((unsigned char)*s < 0x20) fprintf(fp, "\\u%04x", *s);
+    else fputc(*s, fp);
+  }
+  fputc('"', fp);
+}
+
+static void report(FILE *fp, int nr_worker, uint64_t wall_us) {
+  int nr_fail = 0;
+  uint64_t total_inst = 0;
+  fprintf(fp, "{\n  \"workers\": %d,\n  \"wall_us\": %lu,\n  \"jobs\": [\n", nr_worker, wall_us);
+  for (int i = 0; i < nr_job; i ++) {
+    Job *j = &jobs[i];
+    double mips = (j->host_us ? (double)j->nr_inst / j->host_us : 0);
+    fprintf(fp, "    {\"name\": ");
+    json_str(fp, j->name);
+    fprintf(fp, ", \"cmd\": ");
+    json_str(fp, j->cmd);
+    fprintf(fp, ", \"exit\": %d, \"result\": \"%s\", \"insts\": %lu, \"host_us\": %lu, "
+        "\"wall_us\": %lu, \"mips\": %.3f}%s\n", j->exit_code, j->result, j->nr_inst,
+        j->host_us, j->wall_us, mips, (i == nr_job - 1 ? "" : ","));
+    nr_fail += (j->exit_code != 0);
+    total_inst += j->nr_inst;
+  }
+  fprintf(fp, "  ],\n  \"failed\": %d,\n  \"total_insts\": %lu\n}\n", nr_fail, total_inst);
+}
+
+int main(int argc, char *argv[]) {
+  int nr_worker = sysconf(_SC_NPROCESSORS_ONLN);
+  const char *out_file = NULL;
+  int o;
+  while ((o = getopt(argc, argv, "j:o:d:h")) != -1) {
+    switch (o) {
+      case 'j': nr_worker = atoi(optarg); break;
+      case 'o': out_file = optarg; break;
+      case 'd': log_dir = optarg; break;
+      default:
+        printf("Usage: %s [-j N] [-o REPORT.json] [-d LOGDIR] JOBS\n", argv[0]);
+        return 0;
+    }
+  }
+  if (optind != argc - 1) {
+    fprintf(stderr, "Usage: %s [-j N] [-o REPORT.json] [-d LOGDIR] JOBS\n", argv[0]);
+    return 1;
+  }
+
+  load_jobs(argv[optind]);
+  if (nr_worker < 1) nr_worker = 1;
+  if (nr_worker > nr_job) nr_worker = (nr_job > 0 ? nr_job : 1);
+
+  if (mkdir_p(log_dir) != 0) { perror(log_dir); return 1; }
+
+  // keep the numbers printed by NEMU free of thousands separators
+  setenv("LC_ALL", "C", 1);
+
+  uint64_t start = now_us();
+  pthread_t tid[nr_worker];
+  for (int i = 0; i < nr_worker; i ++) {
+    int ret = pthread_create(&tid[i], NULL, worker, NULL);
+    assert(ret == 0);
+  }
+  for (int i = 0; i < nr_worker; i ++) {
+    pthread_join(tid[i], NULL);
+  }
+  uint64_t wall_us = now_us() - start;
+
+  FILE *fp = stdout;
+  if (out_file != NULL) {
+    fp = fopen(out_file, "w");
+    if (fp == NULL) { perror(out_file); return 1; }
+  }
+  report(fp, nr_worker, wall_us);
+  if (fp != stdout) fclose(fp);
+
+  for (int i = 0; i < nr_job; i ++) {
+    if (jobs[i].exit_code != 0) return 1;
+  }
+  return 0;
+}
@@ -119,14 +119,14 @@ int main(int argc, char *argv[]) {
     fputs(code_buf, fp);
     fclose(fp);
 
-    int ret = system("gcc /tmp/.code.c -Wall -Werror -o /tmp/.expr");
+    int ret = system("gcc /tmp/.code.c -Wall -Werror -o /tmp/.expr 2> /dev/null");
     if (ret != 0) continue;
 
     fp = popen("/tmp/.expr", "r");
     assert(fp != NULL);
 
     unsigned long result;
-    ret = fscanf(fp, "%ld", &result);
+    ret = fscanf(fp, "%lu", &result);
     pclose(fp);
 
     printf("%lu %s\n", result, buf);
@@ -0,0 +1,108 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+/* Throughput benchmark of the machine API exported by the NEMU shared
+ * object (build NEMU with "Shared object" as the build target).
+ *
+ * It first runs a countdown loop on one machine, then the same loop on N
+ * machines, each in its own thread, and reports the per-instance MIPS of
+ * both runs. The guest program is riscv only.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+typedef struct Machine Machine;
+
+static Machine* (*machine_create)();
+static void (*machine_destroy)(Machine *m);
+static void (*machine_load)(Machine *m, const void *img, size_t size);
+static int (*machine_run)(Machine *m, uint64_t n);
+
+// iterations of the loop are `LOOP_K << 12', each iteration has 2 instructions
+static uint32_t loop_k = 0x3000;
+
+static uint64_t now_us() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000ull + tv.tv_usec;
+}
+
+static double run_one() {
+  const uint32_t img[] = {
+    (loop_k << 12) | 0x2b7, // lui   t0, LOOP_K
+    0xfff28293,             // addi  t0, t0, -1
+    0xfe029ee3,             // bnez  t0, -4
+    0x00000513,             // li    a0, 0
+    0x00100073,             // ebreak (used as nemu_trap)
+  };
+  uint64_t nr_inst = 1 + 2 * ((uint64_t)loop_k << 12) + 2;
+
+  Machine *m = machine_create();
+  assert(m != NULL);
+  machine_load(m, img, sizeof(img));
+  uint64_t start = now_us();
+  machine_run(m, -1);
+  uint64_t us = now_us() - start;
+  machine_destroy(m);
+  return (double)nr_inst / us;
+}
+
+static void *worker(void *arg) {
+  *(double *)arg = run_one();
+  return NULL;
+}
+
+int main(int argc, char *argv[]) {
+  const char *so = (argc > 1 ? argv[1] : "build/riscv64-nemu-interpreter-so");
+  int nr_thread = (argc > 2 ? atoi(argv[2]) : sysconf(_SC_NPROCESSORS_ONLN));
+  if (argc > 3) loop_k = strtoul(argv[3], NULL, 0);
+  assert(nr_thread > 0 && loop_k > 0 && loop_k < (1 << 20));
+
+  void *handle = dlopen(so, RTLD_LAZY);
+  if (handle == NULL) { fprintf(stderr, "%s\n", dlerror()); return 1; }
+  machine_create = dlsym(handle, "machine_create");
+  machine_destroy = dlsym(handle, "machine_destroy");
+  machine_load = dlsym(handle, "machine_load");
+  machine_run = dlsym(handle, "machine_run");
+  assert(machine_create && machine_destroy && machine_load && machine_run);
+
+  double single = run_one();
+
+  double mips[nr_thread];
+  pthread_t tid[nr_thread];
+  for (int i = 0; i < nr_thread; i ++) {
+    int ret = pthread_create(&tid[i], NULL, worker, &mips[i]);
+    assert(ret == 0);
+  }
+  double sum = 0, min = 1e30;
+  for (int i = 0; i < nr_thread; i ++) {
+    pthread_join(tid[i], NULL);
+    sum += mips[i];
+    if (mips[i] < min) min = mips[i];
+  }
+
+  printf("single instance            : %8.2f MIPS\n", single);
+  printf("%3d instances, per instance: %8.2f MIPS (avg), %8.2f MIPS (min)\n",
+      nr_thread, sum / nr_thread, min);
+  printf("%3d instances, aggregate   : %8.2f MIPS\n", nr_thread, sum);
+  return 0;
+}
@@ -0,0 +1,50 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+/* An example plugin which counts instructions, basic blocks, memory
+ * accesses and traps, and prints them when the guest program ends.
+ *   nemu --plugin=tools/plugins/insn-count/build/insn-count-so IMAGE
+ */
+
+#include <nemu-plugin.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+static uint64_t nr_insn = 0, nr_block = 0, nr_load = 0, nr_store = 0, nr_trap = 0;
+
+static void on_insn(void *udata, uint64_t pc, uint32_t inst) { nr_insn ++; }
+static void on_block(void *udata, uint64_t pc) { nr_block ++; }
+static void on_mem(void *udata, uint64_t addr, int len, bool is_write, uint64_t data) {
+  if (is_write) nr_store ++;
+  else nr_load ++;
+}
+static void on_trap(void *udata, uint64_t cause, uint64_t epc) { nr_trap ++; }
+
+static void on_exit(void *udata) {
+  printf("[insn-count] %" PRIu64 " instructions, %" PRIu64 " blocks (%.2f instructions per block)\n",
+      nr_insn, nr_block, (nr_block == 0 ? 0 : (double)nr_insn / nr_block));
+  printf("[insn-count] %" PRIu64 " loads, %" PRIu64 " stores, %" PRIu64 " traps\n",
+      nr_load, nr_store, nr_trap);
+}
+
+int nemu_plugin_install(const nemu_plugin_api *api, const char *args) {
+  if (api->version != NEMU_PLUGIN_VERSION) return 1;
+  api->register_insn_cb(on_insn, NULL);
+  api->register_block_cb(on_block, NULL);
+  api->register_mem_cb(on_mem, NULL);
+  api->register_trap_cb(on_trap, NULL);
+  api->register_exit_cb(on_exit, NULL);
+  return 0;
+}